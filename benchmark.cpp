@@ -1,34 +1,957 @@
+// Formatting of a few realistic messages with infmt and with the usual
+// alternatives. Time per iteration is time per message. Bytes per second count
+// the chars of the produced message (infmt messages include slot padding).
+#include "infmt.hpp"
+
 #include <benchmark/benchmark.h>
 
+#include <array>
+#include <atomic>
 #include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Values that change every message, so nothing is formatted at compile time
+struct values
+{
+  std::uint64_t seq_no;
+  std::int32_t qty;
+  double price;
+  std::string_view name;
+};
+
+values make_values(std::uint64_t n)
+{
+  constexpr std::array<std::string_view, 4> names = { "alice", "bob",
+                                                      "charlie", "dave" };
+  return { 1'000'000u + n, static_cast<std::int32_t>(n % 5000u) - 2500,
+           100.0 + static_cast<double>(n % 1000u) / 8.0, names[n % 4u] };
+}
 
-constexpr auto value = 1234567890u;
+template <typename T>
+void append_number(std::string& s, T value)
+{
+  char buf[32];
+  const auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+  s.append(buf, end);
+}
 
-static void Inplace(benchmark::State& state)
+void append_fixed(std::string& s, double value, int precision)
 {
-  const auto place = 10u;
-  std::string s = R"#({"foo ": [                    ]})#";
-  auto ptr = s.data() + place;
+  char buf[64];
+  const auto [end, ec] = std::to_chars(
+    buf, buf + sizeof(buf), value, std::chars_format::fixed, precision);
+  s.append(buf, end);
+}
+
+void set_bytes(benchmark::State& state, std::size_t message_size)
+{
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          static_cast<std::int64_t>(message_size));
+}
+
+// Small JSON
+
+constexpr auto json_format =
+  INFMT_STRING(R"({{"seq_no":{uint64_t},"qty":{int32_t},"name":"{str16}"}})");
+
+void JsonInfmt(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(json_format, infmt::track_written);
+  const auto cv = formatter.to_string_view();
+  auto n = 0u;
+
   for (auto _ : state) {
-    std::to_chars(ptr, ptr + 20, value);
-    benchmark::DoNotOptimize(s);
+    const auto v = make_values(n++);
+    formatter.set<0>(v.seq_no);
+    formatter.set_with_fill<1>(v.qty, ' ');
+    formatter.set<2>(v.name);
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
   }
+
+  set_bytes(state, cv.size());
 }
-BENCHMARK(Inplace);
+BENCHMARK(JsonInfmt);
 
-static void StringAppending(benchmark::State& state)
+void JsonInfmtFillHint(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(json_format, infmt::track_written);
+  const auto cv = formatter.to_string_view();
+  // The widest qty that make_values produces
+  const auto qty_hint = formatter.set<1>(-2500);
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    formatter.set<0>(v.seq_no);
+    formatter.set_with_fill_hint<1>(v.qty, ' ', qty_hint);
+    formatter.set<2>(v.name);
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(JsonInfmtFillHint);
+
+void JsonInfmtStats(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(json_format, infmt::track_written,
+                                         infmt::collect_stats);
+  const auto cv = formatter.to_string_view();
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    formatter.set<0>(v.seq_no);
+    formatter.set_with_fill<1>(v.qty, ' ');
+    formatter.set<2>(v.name);
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  benchmark::DoNotOptimize(formatter.stats());
+  set_bytes(state, cv.size());
+}
+BENCHMARK(JsonInfmtStats);
+
+void JsonSnprintf(benchmark::State& state)
 {
   char buf[128];
+  auto size = 0;
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    size = std::snprintf(buf, sizeof(buf),
+                         R"({"seq_no":%llu,"qty":%d,"name":"%.*s"})",
+                         static_cast<unsigned long long>(v.seq_no), v.qty,
+                         static_cast<int>(v.name.size()), v.name.data());
+    benchmark::DoNotOptimize(buf);
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, static_cast<std::size_t>(size));
+}
+BENCHMARK(JsonSnprintf);
+
+void JsonStringAppend(benchmark::State& state)
+{
+  std::string s;
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    s.clear();
+    s.append(R"({"seq_no":)");
+    append_number(s, v.seq_no);
+    s.append(R"(,"qty":)");
+    append_number(s, v.qty);
+    s.append(R"(,"name":")");
+    s.append(v.name);
+    s.append(R"("})");
+    benchmark::DoNotOptimize(s.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, s.size());
+}
+BENCHMARK(JsonStringAppend);
+
+void JsonOstringstream(benchmark::State& state)
+{
+  std::ostringstream os;
+  auto size = std::size_t{};
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    os.str({});
+    os << R"({"seq_no":)" << v.seq_no << R"(,"qty":)" << v.qty
+       << R"(,"name":")" << v.name << R"("})";
+    const auto s = os.str();
+    size = s.size();
+    benchmark::DoNotOptimize(s.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, size);
+}
+BENCHMARK(JsonOstringstream);
+
+// JSON with a user-supplied string that needs escaping
+
+void JsonEscapedInfmt(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(
+    INFMT_STRING(R"({{"seq_no":{uint64_t},"comment":"{jstr64}"}})"),
+    infmt::track_written);
+  const auto cv = formatter.to_string_view();
+  const std::string_view comment =
+    "Order for \"ACME\" corp.\nPlease confirm by C:\\mail\\inbox today";
+  auto n = 0u;
+
+  for (auto _ : state) {
+    formatter.set<0>(1'000'000u + n++);
+    formatter.set<1>(comment);
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(JsonEscapedInfmt);
+
+// Timestamp of consecutive events, microseconds apart
+
+constexpr std::int64_t event_time_ns = 1'700'000'000'000'000'000;
+
+void TimestampInfmt(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(INFMT_STRING("{timestamp_ns}\n"));
+  const auto cv = formatter.to_string_view();
+  auto ns = event_time_ns;
+
+  for (auto _ : state) {
+    formatter.set<0>(ns += 1'234);
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(TimestampInfmt);
+
+void TimestampStrftime(benchmark::State& state)
+{
+  char buf[64];
+  auto size = std::size_t{};
+  auto ns = event_time_ns;
+
+  for (auto _ : state) {
+    ns += 1'234;
+    const auto seconds = static_cast<std::time_t>(ns / 1'000'000'000);
+    std::tm tm{};
+    gmtime_r(&seconds, &tm);
+    size = std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+    size += static_cast<std::size_t>(
+      std::snprintf(buf + size, sizeof(buf) - size, ".%09lldZ\n",
+                    static_cast<long long>(ns % 1'000'000'000)));
+    benchmark::DoNotOptimize(buf);
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, size);
+}
+BENCHMARK(TimestampStrftime);
+
+// Price with 4 decimals, compared with an integer of the same magnitude
+
+void DecimalInfmt(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(
+    INFMT_STRING("px={dec64.4}\n"), infmt::track_written);
+  const auto cv = formatter.to_string_view();
+  auto n = 0u;
+
+  for (auto _ : state) {
+    formatter.set<0>(1'234'567 + static_cast<std::int64_t>(n++ % 1000u));
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(DecimalInfmt);
+
+void DecimalInfmtInteger(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(INFMT_STRING("px={int64_t}\n"),
+                                         infmt::track_written);
+  const auto cv = formatter.to_string_view();
+  auto n = 0u;
+
+  for (auto _ : state) {
+    formatter.set<0>(1'234'567 + static_cast<std::int64_t>(n++ % 1000u));
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(DecimalInfmtInteger);
+
+void DecimalSnprintf(benchmark::State& state)
+{
+  char buf[64];
+  auto size = 0;
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto mantissa = 1'234'567 + static_cast<long long>(n++ % 1000u);
+    size = std::snprintf(buf, sizeof(buf), "px=%lld.%04lld\n",
+                         mantissa / 10000, mantissa % 10000);
+    benchmark::DoNotOptimize(buf);
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, static_cast<std::size_t>(size));
+}
+BENCHMARK(DecimalSnprintf);
+
+// Hex order id and hash
+
+void HexInfmt(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(
+    INFMT_STRING("id={uint64_t:x} hash={uint64_t:0>X}\n"),
+    infmt::track_written);
+  const auto cv = formatter.to_string_view();
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    formatter.set<0>(v.seq_no * 0x9e3779b9u);
+    formatter.set<1>(v.seq_no * 0x9e3779b97f4a7c15u);
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(HexInfmt);
+
+void HexSnprintf(benchmark::State& state)
+{
+  char buf[64];
+  auto size = 0;
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    size = std::snprintf(
+      buf, sizeof(buf), "id=%llx hash=%016llX\n",
+      static_cast<unsigned long long>(v.seq_no * 0x9e3779b9u),
+      static_cast<unsigned long long>(v.seq_no * 0x9e3779b97f4a7c15u));
+    benchmark::DoNotOptimize(buf);
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, static_cast<std::size_t>(size));
+}
+BENCHMARK(HexSnprintf);
+
+// Sequence number, incremented for every message
+
+void SeqNoIncrement(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(
+    INFMT_STRING("seq={uint64_t:0>12}\n"), infmt::track_written);
+  const auto cv = formatter.to_string_view();
+
+  for (auto _ : state) {
+    formatter.increment<0>();
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(SeqNoIncrement);
+
+void SeqNoSet(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(
+    INFMT_STRING("seq={uint64_t:0>12}\n"), infmt::track_written);
+  const auto cv = formatter.to_string_view();
+  auto seq_no = std::uint64_t{};
+
+  for (auto _ : state) {
+    formatter.set<0>(++seq_no);
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(SeqNoSet);
+
+// Wide FIX new order single, with '|' instead of SOH
+
+constexpr auto fix_format = INFMT_STRING(
+  "8=FIX.4.2|9={uint32_t}|35=D|34={uint64_t}|49={str8}|56=EXCHANGE|"
+  "52=20240101-12:00:00.000|11={uint64_t}|1={str16}|21=1|55={str8}|54=1|"
+  "60=20240101-12:00:00.000|38={int32_t}|40=2|44={double:.4}|59=0|"
+  "10={uint8_t:0>}|");
+
+void FixInfmt(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(fix_format, infmt::track_written);
+  const auto cv = formatter.to_string_view();
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    formatter.set<0>(200u);
+    formatter.set<1>(v.seq_no);
+    formatter.set<2>(v.name);
+    formatter.set<3>(v.seq_no * 2u);
+    formatter.set<4>(v.name);
+    formatter.set<5>(std::string_view{ "AAPL" });
+    formatter.set_with_fill<6>(v.qty, ' ');
+    formatter.set_with_fill<7>(v.price, ' ');
+    formatter.set<8>(n % 256u);
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(FixInfmt);
+
+// The same format parsed at runtime
+void FixRuntime(benchmark::State& state)
+{
+  auto formatter = *infmt::make_runtime_formatter(fix_format.to_string_view());
+  const auto cv = formatter.to_string_view();
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    formatter.set(0u, 200u);
+    formatter.set(1u, v.seq_no);
+    formatter.set(2u, v.name);
+    formatter.set(3u, v.seq_no * 2u);
+    formatter.set(4u, v.name);
+    formatter.set(5u, std::string_view{ "AAPL" });
+    formatter.set(6u, v.qty);
+    formatter.set(7u, v.price);
+    formatter.set(8u, n % 256u);
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(FixRuntime);
+
+// Construction only copies the message template built at compile time
+void FixMakeFormatter(benchmark::State& state)
+{
+  for (auto _ : state) {
+    auto formatter = infmt::make_formatter(fix_format, infmt::track_written);
+    benchmark::DoNotOptimize(formatter.to_string_view().data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, infmt::make_formatter(fix_format).size());
+}
+BENCHMARK(FixMakeFormatter);
+
+// The format is parsed and the template built on every construction
+void FixMakeRuntimeFormatter(benchmark::State& state)
+{
+  for (auto _ : state) {
+    auto formatter =
+      infmt::make_runtime_formatter(fix_format.to_string_view());
+    benchmark::DoNotOptimize(formatter->to_string_view().data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, infmt::make_formatter(fix_format).size());
+}
+BENCHMARK(FixMakeRuntimeFormatter);
+
+void FixSnprintf(benchmark::State& state)
+{
+  char buf[512];
+  auto size = 0;
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    const auto name_size = static_cast<int>(v.name.size());
+    size = std::snprintf(
+      buf, sizeof(buf),
+      "8=FIX.4.2|9=%u|35=D|34=%llu|49=%.*s|56=EXCHANGE|"
+      "52=20240101-12:00:00.000|11=%llu|1=%.*s|21=1|55=AAPL|54=1|"
+      "60=20240101-12:00:00.000|38=%d|40=2|44=%.4f|59=0|10=%03u|",
+      200u, static_cast<unsigned long long>(v.seq_no), name_size,
+      v.name.data(), static_cast<unsigned long long>(v.seq_no * 2u),
+      name_size, v.name.data(), v.qty, v.price, n % 256u);
+    benchmark::DoNotOptimize(buf);
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, static_cast<std::size_t>(size));
+}
+BENCHMARK(FixSnprintf);
+
+void FixStringAppend(benchmark::State& state)
+{
+  std::string s;
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    s.clear();
+    s.append("8=FIX.4.2|9=");
+    append_number(s, 200u);
+    s.append("|35=D|34=");
+    append_number(s, v.seq_no);
+    s.append("|49=");
+    s.append(v.name);
+    s.append("|56=EXCHANGE|52=20240101-12:00:00.000|11=");
+    append_number(s, v.seq_no * 2u);
+    s.append("|1=");
+    s.append(v.name);
+    s.append("|21=1|55=AAPL|54=1|60=20240101-12:00:00.000|38=");
+    append_number(s, v.qty);
+    s.append("|40=2|44=");
+    append_fixed(s, v.price, 4);
+    s.append("|59=0|10=");
+    append_number(s, n % 256u);
+    s.append("|");
+    benchmark::DoNotOptimize(s.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, s.size());
+}
+BENCHMARK(FixStringAppend);
+
+void FixOstringstream(benchmark::State& state)
+{
+  std::ostringstream os;
+  os.setf(std::ios::fixed);
+  os.precision(4);
+  auto size = std::size_t{};
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    os.str({});
+    os << "8=FIX.4.2|9=" << 200u << "|35=D|34=" << v.seq_no
+       << "|49=" << v.name << "|56=EXCHANGE|52=20240101-12:00:00.000|11="
+       << v.seq_no * 2u << "|1=" << v.name
+       << "|21=1|55=AAPL|54=1|60=20240101-12:00:00.000|38=" << v.qty
+       << "|40=2|44=" << v.price << "|59=0|10=" << n % 256u << "|";
+    const auto s = os.str();
+    size = s.size();
+    benchmark::DoNotOptimize(s.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, size);
+}
+BENCHMARK(FixOstringstream);
+
+// FIX message with BodyLength and CheckSum, sent without padding. The
+// formatter keeps both up to date, or they are computed after the sets.
+
+void FixChecksumInfmt(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(
+    INFMT_STRING("8=FIX.4.2|9={len:body..trailer}|{body:mark}35=D|"
+                 "34={uint64_t}|49={str8}|56=EXCHANGE|11={uint64_t}|"
+                 "55={str8}|38={int32_t}|44={dec64.4}|{trailer:mark}"
+                 "10={fixsum:..trailer}|"),
+    infmt::track_written);
+  char out[decltype(formatter)::size()];
+  auto size = std::size_t{};
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    formatter.set_all(v.seq_no, v.name, v.seq_no * 2u, "AAPL", v.qty,
+                      static_cast<std::int64_t>(v.price * 10000.0));
+    size = static_cast<std::size_t>(formatter.copy_to(out) - out);
+    benchmark::DoNotOptimize(out);
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, size);
+}
+BENCHMARK(FixChecksumInfmt);
+
+void FixChecksumRecompute(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(
+    INFMT_STRING("8=FIX.4.2|9={uint32_t}|35=D|34={uint64_t}|49={str8}|"
+                 "56=EXCHANGE|11={uint64_t}|55={str8}|38={int32_t}|"
+                 "44={dec64.4}|10={uint8_t:0>}|"),
+    infmt::track_written);
+  char out[decltype(formatter)::size()];
+  auto size = std::size_t{};
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    formatter.set_all(0u, v.seq_no, v.name, v.seq_no * 2u, "AAPL", v.qty,
+                      static_cast<std::int64_t>(v.price * 10000.0), 0u);
+
+    // Body is between `8=FIX.4.2|9=...|` and `10=000|`
+    auto end = formatter.copy_to(out);
+    formatter.set<0>(static_cast<std::uint32_t>(
+      (end - out) - 13 - formatter.written_length<0>() - 7));
+    end = formatter.copy_to(out);
+    auto sum = 0u;
+    for (auto it = out; it != end - 7; ++it) {
+      sum += static_cast<unsigned char>(*it);
+    }
+    formatter.set<7>(static_cast<std::uint8_t>(sum));
+    size = static_cast<std::size_t>(formatter.copy_to(out) - out);
+    benchmark::DoNotOptimize(out);
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, size);
+}
+BENCHMARK(FixChecksumRecompute);
+
+// The same message with the CRC-32C of the body instead of the checksum, in
+// fixed width fields. The formatter patches the CRC with the change of every
+// slot. Build with `-msse4.2` for the `crc32` instruction, the table is used
+// otherwise.
+constexpr auto fix_crc_format = INFMT_STRING(
+  "8=FIX.4.2|9={len:body..trailer}|{body:mark}35=D|34={uint64_t:0>}|"
+  "49={str8:<}|56=EXCHANGE|11={uint64_t:0>}|55={str8:<}|38={int32_t:>}|"
+  "44={dec64.4:>}|{trailer:mark}93={crc32c:body..trailer}|");
+
+void FixCrcInfmt(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(fix_crc_format);
+  const auto cv = formatter.to_string_view();
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    formatter.set_all(v.seq_no, v.name, v.seq_no * 2u, "AAPL", v.qty,
+                      static_cast<std::int64_t>(v.price * 10000.0));
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(FixCrcInfmt);
+
+// Only the price changes, the CRC is patched with its slot
+void FixCrcInfmtPrice(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(fix_crc_format);
+  const auto cv = formatter.to_string_view();
+  const auto v = make_values(0u);
+  formatter.set_all(v.seq_no, v.name, v.seq_no * 2u, "AAPL", v.qty,
+                    static_cast<std::int64_t>(v.price * 10000.0));
+  auto n = 0u;
+
+  for (auto _ : state) {
+    formatter.set<7>(static_cast<std::int64_t>(n++));
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(FixCrcInfmtPrice);
+
+// The same, with the CRC computed after the sets
+void FixCrcRecompute(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(INFMT_STRING(
+    "8=FIX.4.2|9={uint32_t}|35=D|34={uint64_t:0>}|49={str8:<}|56=EXCHANGE|"
+    "11={uint64_t:0>}|55={str8:<}|38={int32_t:>}|44={dec64.4:>}|"
+    "93={uint32_t:0>x}|"));
+  using formatter_t = decltype(formatter);
+  const auto cv = formatter.to_string_view();
+  const auto body_begin = cv.find("35=D|");
+  const auto body_end = formatter_t::slot_range(7u).offset - 3u;
+  formatter.set<0>(static_cast<std::uint32_t>(body_end - body_begin));
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    formatter.set_some<1, 2, 3, 4, 5, 6>(
+      v.seq_no, v.name, v.seq_no * 2u, "AAPL", v.qty,
+      static_cast<std::int64_t>(v.price * 10000.0));
+    formatter.set<7>(~infmt::details::crc32c_update(
+      ~std::uint32_t{}, cv.data() + body_begin, body_end - body_begin));
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(FixCrcRecompute);
+
+// With `track_written` chars move with lengths of values, so the CRC is
+// computed again, once per `set_all`
+void FixCrcInfmtTracked(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(
+    INFMT_STRING("8=FIX.4.2|9={len:body..trailer}|{body:mark}35=D|"
+                 "34={uint64_t}|49={str8}|56=EXCHANGE|11={uint64_t}|"
+                 "55={str8}|38={int32_t}|44={dec64.4}|{trailer:mark}"
+                 "93={crc32c:body..trailer}|"),
+    infmt::track_written);
+  char out[decltype(formatter)::size()];
+  auto size = std::size_t{};
+  auto n = 0u;
+
   for (auto _ : state) {
-    const auto [end, ec] = std::to_chars(buf, buf + 20, value);
-    std::string s;
-    s.reserve(128);
-    s.append(R"#({"foo ":)#");
-    s.append(buf, end);
-    s.append("]}");
-    benchmark::DoNotOptimize(s);
+    const auto v = make_values(n++);
+    formatter.set_all(v.seq_no, v.name, v.seq_no * 2u, "AAPL", v.qty,
+                      static_cast<std::int64_t>(v.price * 10000.0));
+    size = static_cast<std::size_t>(formatter.copy_to(out) - out);
+    benchmark::DoNotOptimize(out);
+    benchmark::ClobberMemory();
   }
+
+  set_bytes(state, size);
+}
+BENCHMARK(FixCrcInfmtTracked);
+
+// Log line
+
+constexpr auto log_format = INFMT_STRING(
+  "2024-01-01 12:00:00.000 [INFO] {str8:<} order {uint64_t} filled "
+  "{int32_t:>} @ {double:.2}\n");
+
+void LogInfmt(benchmark::State& state)
+{
+  auto formatter = infmt::make_formatter(log_format);
+  const auto cv = formatter.to_string_view();
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    formatter.set<0>(v.name);
+    formatter.set<1>(v.seq_no);
+    formatter.set<2>(v.qty);
+    formatter.set_with_fill<3>(v.price, ' ');
+    benchmark::DoNotOptimize(cv.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, cv.size());
+}
+BENCHMARK(LogInfmt);
+
+void LogSnprintf(benchmark::State& state)
+{
+  char buf[256];
+  auto size = 0;
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    size = std::snprintf(
+      buf, sizeof(buf),
+      "2024-01-01 12:00:00.000 [INFO] %-8.*s order %llu filled %11d @ "
+      "%.2f\n",
+      static_cast<int>(v.name.size()), v.name.data(),
+      static_cast<unsigned long long>(v.seq_no), v.qty, v.price);
+    benchmark::DoNotOptimize(buf);
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, static_cast<std::size_t>(size));
+}
+BENCHMARK(LogSnprintf);
+
+void LogStringAppend(benchmark::State& state)
+{
+  std::string s;
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    s.clear();
+    s.append("2024-01-01 12:00:00.000 [INFO] ");
+    s.append(v.name);
+    s.append(8u - v.name.size(), ' ');
+    s.append(" order ");
+    append_number(s, v.seq_no);
+    s.append(" filled ");
+    append_number(s, v.qty);
+    s.append(" @ ");
+    append_fixed(s, v.price, 2);
+    s.append("\n");
+    benchmark::DoNotOptimize(s.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, s.size());
+}
+BENCHMARK(LogStringAppend);
+
+void LogOstringstream(benchmark::State& state)
+{
+  std::ostringstream os;
+  os.setf(std::ios::fixed);
+  os.precision(2);
+  auto size = std::size_t{};
+  auto n = 0u;
+
+  for (auto _ : state) {
+    const auto v = make_values(n++);
+    os.str({});
+    os << "2024-01-01 12:00:00.000 [INFO] " << v.name
+       << std::string_view{ "        ", 8u - v.name.size() } << " order "
+       << v.seq_no << " filled " << v.qty << " @ " << v.price << "\n";
+    const auto s = os.str();
+    size = s.size();
+    benchmark::DoNotOptimize(s.data());
+    benchmark::ClobberMemory();
+  }
+
+  set_bytes(state, size);
+}
+BENCHMARK(LogOstringstream);
+
+// Export of many rows through one template. Time per iteration is time per
+// batch of `export_rows` rows.
+
+constexpr auto export_format = INFMT_STRING(
+  "{uint64_t:>},{int32_t:>},{dec64.4:>},{str8:<},{timestamp_ns}\n");
+using export_formatter = decltype(infmt::make_formatter(export_format));
+constexpr auto export_rows = 10'000u;
+
+struct export_columns
+{
+  std::vector<std::uint64_t> seq_no;
+  std::vector<std::int32_t> qty;
+  std::vector<std::int64_t> price;
+  std::vector<std::string_view> name;
+  std::vector<std::int64_t> time;
+};
+
+export_columns make_export_columns()
+{
+  export_columns columns;
+  for (auto n = 0u; n < export_rows; ++n) {
+    const auto v = make_values(n);
+    columns.seq_no.push_back(v.seq_no);
+    columns.qty.push_back(v.qty);
+    columns.price.push_back(static_cast<std::int64_t>(v.price * 10000.0));
+    columns.name.push_back(v.name);
+    columns.time.push_back(1'700'000'000'000'000'000 +
+                           std::int64_t{ n } * 1'000'000);
+  }
+  return columns;
+}
+
+void ExportSetAll(benchmark::State& state)
+{
+  const auto c = make_export_columns();
+  std::vector<char> arena(export_rows * export_formatter::size());
+  auto formatter = infmt::make_formatter(export_format);
+
+  for (auto _ : state) {
+    auto out = arena.data();
+    for (auto row = 0u; row < export_rows; ++row) {
+      formatter.set_all(c.seq_no[row], c.qty[row], c.price[row], c.name[row],
+                        c.time[row]);
+      const auto cv = formatter.to_string_view();
+      std::memcpy(out, cv.data(), cv.size());
+      out += cv.size();
+    }
+    benchmark::DoNotOptimize(arena.data());
+    benchmark::ClobberMemory();
+  }
+
+  state.SetItemsProcessed(state.iterations() * export_rows);
+  set_bytes(state, arena.size());
+}
+BENCHMARK(ExportSetAll);
+
+// Threads split the rows of one arena
+void ExportFormatRows(benchmark::State& state)
+{
+  static const auto c = make_export_columns();
+  static std::vector<char> arena(export_rows * export_formatter::size());
+  const auto threads = static_cast<std::size_t>(state.threads());
+  const auto thread = static_cast<std::size_t>(state.thread_index());
+  const auto first = export_rows * thread / threads;
+  const auto last = export_rows * (thread + 1u) / threads;
+
+  for (auto _ : state) {
+    export_formatter::format_rows(arena.data(), first, last, c.seq_no, c.qty,
+                                  c.price, c.name, c.time);
+    benchmark::DoNotOptimize(arena.data());
+    benchmark::ClobberMemory();
+  }
+
+  state.SetItemsProcessed(
+    static_cast<std::int64_t>(state.iterations() * (last - first)));
+  set_bytes(state, (last - first) * export_formatter::size());
+}
+BENCHMARK(ExportFormatRows)->ThreadRange(1, 4)->UseRealTime();
+
+// Status line read by many threads while one thread keeps updating it
+
+constexpr auto status_format = INFMT_STRING(
+  "seq={uint64_t} qty={int32_t:>} px={double:.2} user={str8:<}\n");
+
+auto status = infmt::make_seqlock_formatter(status_format);
+std::atomic<bool> status_writer_stop{ false };
+std::thread status_writer;
+
+void StartStatusWriter(const benchmark::State&)
+{
+  status_writer_stop = false;
+  status_writer = std::thread{ [] {
+    auto n = 0u;
+    while (!status_writer_stop.load(std::memory_order_relaxed)) {
+      const auto v = make_values(n++);
+      status.update([&v](auto& f) {
+        f.set_all(v.seq_no, v.qty, v.price, v.name);
+      });
+
+      // A status changes often, but not back to back
+      const auto next = std::chrono::steady_clock::now() +
+                        std::chrono::microseconds{ 1 };
+      while (std::chrono::steady_clock::now() < next) {
+      }
+    }
+  } };
+}
+
+void StopStatusWriter(const benchmark::State&)
+{
+  status_writer_stop = true;
+  status_writer.join();
+}
+
+void SeqlockRead(benchmark::State& state)
+{
+  char out[decltype(status)::size()];
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(status.read(out));
+    benchmark::ClobberMemory();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  set_bytes(state, sizeof(out));
+}
+BENCHMARK(SeqlockRead)
+  ->Setup(StartStatusWriter)
+  ->Teardown(StopStatusWriter)
+  ->ThreadRange(1, 8)
+  ->UseRealTime();
+
 }
-BENCHMARK(StringAppending);
 
-BENCHMARK_MAIN();
\ No newline at end of file
+BENCHMARK_MAIN();
@@ -0,0 +1,46 @@
+// Compile time benchmark of parsing big format strings. Compile with
+// `-DINFMT_BENCH_PARAMS=10`, `100` or `1000`. See the `compile_bench` target.
+#include "infmt.hpp"
+
+#include <iostream>
+
+#ifndef INFMT_BENCH_PARAMS
+#  define INFMT_BENCH_PARAMS 10
+#endif
+
+// Ten params of different kinds
+#define INFMT_BENCH_10                                                        \
+  "a={uint32_t}|b={int64_t:>}|c={str8}|d={uint8_t}|e={int16_t:0>}|"           \
+  "f={bool}|g={uint64_t}|h={str16:<}|i={int32_t}|j={double}|"
+#define INFMT_BENCH_100                                                       \
+  INFMT_BENCH_10 INFMT_BENCH_10 INFMT_BENCH_10 INFMT_BENCH_10                 \
+    INFMT_BENCH_10 INFMT_BENCH_10 INFMT_BENCH_10 INFMT_BENCH_10               \
+      INFMT_BENCH_10 INFMT_BENCH_10
+#define INFMT_BENCH_1000                                                      \
+  INFMT_BENCH_100 INFMT_BENCH_100 INFMT_BENCH_100 INFMT_BENCH_100             \
+    INFMT_BENCH_100 INFMT_BENCH_100 INFMT_BENCH_100 INFMT_BENCH_100           \
+      INFMT_BENCH_100 INFMT_BENCH_100
+
+#if INFMT_BENCH_PARAMS == 10
+#  define INFMT_BENCH_FORMAT INFMT_BENCH_10
+#elif INFMT_BENCH_PARAMS == 100
+#  define INFMT_BENCH_FORMAT INFMT_BENCH_100
+#elif INFMT_BENCH_PARAMS == 1000
+#  define INFMT_BENCH_FORMAT INFMT_BENCH_1000
+#else
+#  error "INFMT_BENCH_PARAMS must be 10, 100 or 1000"
+#endif
+
+int main()
+{
+  auto formatter =
+    infmt::make_formatter(INFMT_STRING(INFMT_BENCH_FORMAT "\n"));
+
+  formatter.set<0>(42u);
+  formatter.set<INFMT_BENCH_PARAMS / 2 + 2>(std::string_view{ "middle" });
+  formatter.set<INFMT_BENCH_PARAMS - 1>(0.5);
+
+  char out[sizeof(formatter)];
+  const auto end = formatter.copy_to(out);
+  std::cout.write(out, end - out);
+}
@@ -57,4 +57,13 @@ int main()
   const auto max_fill_hint2 = formatter.set<1>(12345);
   formatter.set_with_fill_hint<1>(42, '.', max_fill_hint2);
   std::cout << "JSON 5:" << cv << "\n";
+
+  // With `track_written`, the formatter remembers where every value ends, so
+  // a plain `set` clears only the chars left by a longer previous value.
+  auto tracking_formatter =
+    infmt::make_formatter(format_str, infmt::track_written);
+  const auto tracking_cv = tracking_formatter.to_string_view();
+  tracking_formatter.set<1>(12345);
+  tracking_formatter.set<1>(42);
+  std::cout << "JSON 6:" << tracking_cv << "\n";
 }
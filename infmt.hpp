@@ -1,12 +1,30 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bitset>
 #include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <limits>
 #include <optional>
+#include <string>
 #include <string_view>
-#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#  include <immintrin.h>
+#endif
+
+#if __has_include(<sys/uio.h>)
+#  include <sys/uio.h>
+#  define INFMT_HAS_IOVEC 1
+#endif
 
 #define INFMT_STRING(s)                                                       \
   [] {                                                                        \
@@ -31,6 +49,44 @@
 
 namespace infmt {
 
+// Formatter options, passed to `make_formatter` after the format string.
+
+// The formatter remembers where the value of every param ends. `set` then
+// clears chars left by a longer previous value, and only them.
+struct track_written_t
+{
+};
+inline constexpr track_written_t track_written{};
+
+// The formatter remembers which params were set since the last `take_dirty`,
+// so that only their slots need to be propagated.
+struct track_dirty_t
+{
+};
+inline constexpr track_dirty_t track_dirty{};
+
+// The formatter counts, per param, writes, values that didn't fit and chars
+// written and filled. See `stats`.
+struct collect_stats_t
+{
+};
+inline constexpr collect_stats_t collect_stats{};
+
+// Counters of a param, kept with `collect_stats`.
+struct param_stats
+{
+  // Times the param was written, including updates of derived params
+  std::uint64_t writes{};
+  // Strings that were truncated and floating point values that didn't fit
+  // with their precision
+  std::uint64_t overflows{};
+  // Chars of the values. Fill chars in front of right aligned values count
+  // as fill.
+  std::uint64_t bytes_written{};
+  // Chars of padding and of cleared stale values
+  std::uint64_t bytes_filled{};
+};
+
 namespace details {
 template <typename It, typename Value>
 constexpr auto find(It begin, It end, const Value& val)
@@ -45,6 +101,75 @@ constexpr auto find(It begin, It end, const Value& val)
   return end;
 }
 
+template <typename It, typename Pred>
+constexpr auto find_if(It begin, It end, Pred pred)
+{
+  while (begin != end) {
+    if (pred(*begin)) {
+      return begin;
+    }
+    ++begin;
+  }
+
+  return end;
+}
+
+// During constant evaluation, plain loops are noticeably cheaper than
+// `std::string_view` members. Big format strings are parsed with them.
+template <std::size_t N>
+constexpr bool starts_with(std::string_view s, const char (&prefix)[N])
+{
+  if (s.size() < N - 1u) {
+    return false;
+  }
+
+  for (auto i = 0u; i < N - 1u; ++i) {
+    if (s[i] != prefix[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+template <std::size_t N>
+constexpr bool equals(std::string_view s, const char (&str)[N])
+{
+  return s.size() == N - 1u && starts_with(s, str);
+}
+
+constexpr bool equals(std::string_view lhs, std::string_view rhs)
+{
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+
+  for (auto i = 0u; i < lhs.size(); ++i) {
+    if (lhs[i] != rhs[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+constexpr bool is_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+// Non-empty and digits only
+constexpr bool is_number(std::string_view s)
+{
+  for (const auto c : s) {
+    if (!is_digit(c)) {
+      return false;
+    }
+  }
+
+  return !s.empty();
+}
+
 template <typename InIt, typename OutIt>
 constexpr auto copy(InIt begin, InIt end, OutIt out)
 {
@@ -78,7 +203,11 @@ template <typename T>
 constexpr unsigned max_chars_in_type(unsigned base = 10)
 {
   unsigned count{};
-  auto value = std::numeric_limits<T>::max();
+  // Magnitude of the minimum of signed types has the most digits, e.g. -128
+  // is -10000000 in base 2, but 127 is 1111111.
+  auto value =
+    static_cast<std::make_unsigned_t<T>>(std::numeric_limits<T>::max()) +
+    std::uintmax_t{ std::is_signed_v<T> };
 
   while (value > 0u) {
     ++count;
@@ -88,16 +217,463 @@ constexpr unsigned max_chars_in_type(unsigned base = 10)
   return count + std::is_signed_v<T>;
 }
 
+// Length of the longest shortest round-trip representation, e.g.
+// `-2.2250738585072014e-308` for double.
 template <typename T>
 constexpr unsigned max_chars_in_floating_type()
 {
-  if constexpr (std::is_same_v<T, float>) {
-    return 48u;
-  } else if constexpr (std::is_same_v<T, double>) {
-    return 327u;
+  auto exponent_digits = 0u;
+  for (auto value = std::numeric_limits<T>::max_exponent10; value > 0;
+       value /= 10) {
+    ++exponent_digits;
+  }
+
+  // Minus, dot, 'e' and sign of the exponent
+  constexpr auto non_digits = 4u;
+  return std::numeric_limits<T>::max_digits10 + non_digits + exponent_digits;
+}
+
+// Pairs of decimal digits "00" to "99", so two digits are produced per
+// division.
+inline constexpr char digit_pairs[] = "00010203040506070809"
+                                      "10111213141516171819"
+                                      "20212223242526272829"
+                                      "30313233343536373839"
+                                      "40414243444546474849"
+                                      "50515253545556575859"
+                                      "60616263646566676869"
+                                      "70717273747576777879"
+                                      "80818283848586878889"
+                                      "90919293949596979899";
+
+// First entry is 0, so that value 0 is counted as one digit.
+inline constexpr std::uint64_t powers_of_10[] = {
+  0u,
+  10u,
+  100u,
+  1000u,
+  10000u,
+  100000u,
+  1000000u,
+  10000000u,
+  100000000u,
+  1000000000u,
+  10000000000u,
+  100000000000u,
+  1000000000000u,
+  10000000000000u,
+  100000000000000u,
+  1000000000000000u,
+  10000000000000000u,
+  100000000000000000u,
+  1000000000000000000u,
+  10000000000000000000u
+};
+
+inline unsigned count_digits(std::uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  // Approximate log10 from the bit width (1233 / 4096 ~ log10(2)) and correct
+  // it with a single compare.
+  const auto approx = static_cast<unsigned>(
+    (64 - __builtin_clzll(value | 1u)) * 1233 >> 12);
+  return approx - (value < powers_of_10[approx]) + 1u;
+#else
+  unsigned count{ 1u };
+  while (value >= 10u) {
+    value /= 10u;
+    ++count;
+  }
+  return count;
+#endif
+}
+
+// Writes exactly eight digits of `value` (zero padded) before `end`.
+inline char* write_8_digits_backward(char* end, std::uint32_t value)
+{
+  for (auto i = 0u; i < 4u; ++i) {
+    end -= 2;
+    std::memcpy(end, &digit_pairs[(value % 100u) * 2u], 2u);
+    value /= 100u;
+  }
+
+  return end;
+}
+
+// Writes digits of `value` so that the last one lands right before `end`.
+// Returns pointer to the first written digit.
+inline char* write_digits_backward(char* end, std::uint32_t value)
+{
+  while (value >= 100u) {
+    end -= 2;
+    std::memcpy(end, &digit_pairs[(value % 100u) * 2u], 2u);
+    value /= 100u;
+  }
+
+  if (value >= 10u) {
+    end -= 2;
+    std::memcpy(end, &digit_pairs[value * 2u], 2u);
+  } else {
+    *--end = static_cast<char>('0' + value);
+  }
+
+  return end;
+}
+
+inline char* write_digits_backward(char* end, std::uint64_t value)
+{
+  // Peel off 8 digits at a time, so the rest of the work is done in cheaper
+  // 32 bit arithmetic.
+  while (value > std::numeric_limits<std::uint32_t>::max()) {
+    end = write_8_digits_backward(
+      end, static_cast<std::uint32_t>(value % 100000000u));
+    value /= 100000000u;
+  }
+
+  return write_digits_backward(end, static_cast<std::uint32_t>(value));
+}
+
+// Decimal digits of the maximum value of `T`
+template <typename T>
+inline constexpr auto max_value_digits = [] {
+  std::array<char, max_chars_in_type<T>()> digits{};
+  auto value = std::numeric_limits<T>::max();
+  for (auto i = digits.size(); i > 0u; --i) {
+    digits[i - 1u] = static_cast<char>('0' + value % 10u);
+    value /= 10u;
+  }
+  return digits;
+}();
+
+// Value of decimal digits in [first, last), modulo 2^64. Other chars, like
+// fill, count as zeros.
+inline std::uint64_t parse_digits(const char* first, const char* last)
+{
+  auto value = std::uint64_t{};
+  for (; first != last; ++first) {
+    value = value * 10u + (is_digit(*first) ? *first - '0' : 0u);
+  }
+  return value;
+}
+
+// Digits of bases 2 to 16
+inline constexpr char lower_digits[] = "0123456789abcdef";
+inline constexpr char upper_digits[] = "0123456789ABCDEF";
+
+constexpr unsigned log2_of(unsigned value)
+{
+  auto result = 0u;
+  while (value > 1u) {
+    value >>= 1u;
+    ++result;
+  }
+  return result;
+}
+
+// Number of digits of `value` in `Base`, which is 10 or a power of two.
+template <unsigned Base>
+inline unsigned count_digits_in_base(std::uint64_t value)
+{
+  if constexpr (Base == 10u) {
+    return count_digits(value);
+  } else {
+    constexpr auto bits_per_digit = log2_of(Base);
+#if defined(__GNUC__) || defined(__clang__)
+    const auto bits = 64u - static_cast<unsigned>(__builtin_clzll(value | 1u));
+#else
+    auto bits = 1u;
+    while (value >>= 1u) {
+      ++bits;
+    }
+#endif
+    return (bits + bits_per_digit - 1u) / bits_per_digit;
+  }
+}
+
+#if defined(__SSE2__) && defined(__x86_64__)
+// Writes all 16 hex digits of `value`, zero padded, at `first`. Every nibble
+// goes to its own byte and all the bytes are turned into digits at once.
+template <bool Uppercase>
+inline void write_16_hex_digits(char* first, std::uint64_t value)
+{
+  // Most significant byte first
+  const auto bytes =
+    _mm_cvtsi64_si128(static_cast<long long>(__builtin_bswap64(value)));
+  const auto low_nibble_mask = _mm_set1_epi8(0x0f);
+  const auto high = _mm_and_si128(_mm_srli_epi64(bytes, 4), low_nibble_mask);
+  const auto low = _mm_and_si128(bytes, low_nibble_mask);
+  const auto nibbles = _mm_unpacklo_epi8(high, low);
+
+  // '0' + n, and for n > 9 the distance from '9' + 1 to 'a' (or 'A') on top
+  const auto letters = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+  const auto letter_offset = _mm_set1_epi8(Uppercase ? 'A' - '0' - 10
+                                                     : 'a' - '0' - 10);
+  const auto digits =
+    _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')),
+                 _mm_and_si128(letters, letter_offset));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(first), digits);
+}
+#endif
+
+// `write_digits_backward` for any `Base` that is 10 or a power of two.
+template <unsigned Base, bool Uppercase, typename Magnitude>
+inline char* write_digits_backward_in_base(char* end, Magnitude value)
+{
+  if constexpr (Base == 10u) {
+    return write_digits_backward(end, value);
+  } else {
+#if defined(__SSE2__) && defined(__x86_64__)
+    if constexpr (Base == 16u && sizeof(Magnitude) == 8u) {
+      char digits[16];
+      write_16_hex_digits<Uppercase>(digits, value);
+      const auto count = count_digits_in_base<16u>(value);
+      const auto begin = std::prev(end, count);
+      std::memcpy(begin, std::prev(std::end(digits), count), count);
+      return begin;
+    }
+#endif
+    constexpr auto bits_per_digit = log2_of(Base);
+    constexpr auto& digits = Uppercase ? upper_digits : lower_digits;
+
+    do {
+      *--end = digits[value & (Base - 1u)];
+      value >>= bits_per_digit;
+    } while (value != 0u);
+
+    return end;
+  }
+}
+
+template <typename T>
+using integer_magnitude_t =
+  std::conditional_t<(sizeof(T) > sizeof(std::uint32_t)), std::uint64_t,
+                     std::uint32_t>;
+
+// Writes `value` in `Base` starting at `first`. Returns pointer past the last
+// char. There must be room for `max_chars_in_type<T>(Base)` chars.
+template <unsigned Base = 10u, bool Uppercase = false, typename T>
+inline char* write_integer(char* first, T value)
+{
+  using magnitude_t = integer_magnitude_t<T>;
+  auto magnitude = static_cast<magnitude_t>(value);
+
+  if constexpr (std::is_signed_v<T>) {
+    if (value < 0) {
+      *first++ = '-';
+      magnitude = magnitude_t{ 0u } - magnitude;
+    }
+  }
+
+  const auto end = std::next(first, count_digits_in_base<Base>(magnitude));
+  write_digits_backward_in_base<Base, Uppercase>(end, magnitude);
+  return end;
+}
+
+// Writes `value` so that it ends at `first + Length` and pads the beginning
+// with `fill`. With '0' fill the sign goes in front of the padding.
+// Returns pointer past the slot.
+template <unsigned Length, unsigned Base = 10u, bool Uppercase = false,
+          typename T>
+inline char* write_integer_right_aligned(char* first, T value, char fill)
+{
+  using magnitude_t = integer_magnitude_t<T>;
+  auto magnitude = static_cast<magnitude_t>(value);
+  const auto end = std::next(first, Length);
+
+  std::memset(first, fill, Length);
+
+  if constexpr (std::is_signed_v<T>) {
+    if (value < 0) {
+      magnitude = magnitude_t{ 0u } - magnitude;
+      const auto digits_begin =
+        write_digits_backward_in_base<Base, Uppercase>(end, magnitude);
+      *(fill == '0' ? first : std::prev(digits_begin)) = '-';
+      return end;
+    }
+  }
+
+  write_digits_backward_in_base<Base, Uppercase>(end, magnitude);
+  return end;
+}
+
+// "true" padded with `Fill` to the length of "false", followed by "false".
+// Either value is then a copy of 5 chars from offset 0 or 5.
+template <char Fill, bool PadFront>
+inline constexpr std::array<char, 10u> bool_patterns =
+  PadFront ? std::array<char, 10u>{ Fill, 't', 'r', 'u', 'e',
+                                    'f',  'a', 'l', 's', 'e' }
+           : std::array<char, 10u>{ 't', 'r', 'u', 'e', Fill,
+                                    'f', 'a', 'l', 's', 'e' };
+
+template <char Fill, bool PadFront>
+inline void write_bool_pattern(char* first, bool value)
+{
+  std::memcpy(first, &bool_patterns<Fill, PadFront>[5u * !value], 5u);
+}
+
+// Writes exactly `Count` digits of `value` (zero padded) before `end`.
+// Returns pointer to the first written digit.
+template <unsigned Count>
+inline char* write_fixed_digits_backward(char* end, std::uint64_t value)
+{
+  auto count = Count;
+
+  while (count >= 8u) {
+    end = write_8_digits_backward(
+      end, static_cast<std::uint32_t>(value % 100000000u));
+    value /= 100000000u;
+    count -= 8u;
+  }
+
+  while (count >= 2u) {
+    end -= 2;
+    std::memcpy(end, &digit_pairs[(value % 100u) * 2u], 2u);
+    value /= 100u;
+    count -= 2u;
+  }
+
+  if (count != 0u) {
+    *--end = static_cast<char>('0' + value % 10u);
+  }
+
+  return end;
+}
+
+// Writes `magnitude / 10^Scale`, dot and `Scale` digits of the fraction, so
+// that the last digit lands right before `end`. Returns pointer to the first
+// written char. Scale is a compile time constant, so the division is
+// a multiplication.
+template <unsigned Scale>
+inline char* write_decimal_backward(char* end, std::uint64_t magnitude)
+{
+  static_assert(Scale <= 19u, "dec64 can't have more than 19 decimals");
+
+  if constexpr (Scale == 0u) {
+    return write_digits_backward(end, magnitude);
+  } else {
+    constexpr auto divisor = powers_of_10[Scale];
+    end = write_fixed_digits_backward<Scale>(end, magnitude % divisor);
+    *--end = '.';
+    return write_digits_backward(end, magnitude / divisor);
+  }
+}
+
+// Writes fixed-point `mantissa` with `Scale` decimals at `first`. Returns
+// pointer past the last written char.
+template <unsigned Scale>
+inline char* write_decimal(char* first, std::int64_t mantissa)
+{
+  auto magnitude = static_cast<std::uint64_t>(mantissa);
+  if (mantissa < 0) {
+    *first++ = '-';
+    magnitude = std::uint64_t{ 0u } - magnitude;
+  }
+
+  auto length = 0u;
+  if constexpr (Scale == 0u) {
+    length = count_digits(magnitude);
   } else {
-    return 4954u;
+    length = count_digits(magnitude / powers_of_10[Scale]) + 1u + Scale;
+  }
+
+  const auto end = std::next(first, length);
+  write_decimal_backward<Scale>(end, magnitude);
+  return end;
+}
+
+// `write_decimal` that ends the value at `first + Length` and pads the
+// beginning with `fill`, like `write_integer_right_aligned`.
+template <unsigned Length, unsigned Scale>
+inline char* write_decimal_right_aligned(char* first, std::int64_t mantissa,
+                                         char fill)
+{
+  const auto end = std::next(first, Length);
+  auto magnitude = static_cast<std::uint64_t>(mantissa);
+
+  std::memset(first, fill, Length);
+
+  if (mantissa < 0) {
+    magnitude = std::uint64_t{ 0u } - magnitude;
+    const auto begin = write_decimal_backward<Scale>(end, magnitude);
+    *(fill == '0' ? first : std::prev(begin)) = '-';
+    return end;
+  }
+
+  write_decimal_backward<Scale>(end, magnitude);
+  return end;
+}
+
+// Marks that no precision is given. Floating point values are written in
+// the shortest round-trip form then.
+inline constexpr auto no_precision = std::numeric_limits<unsigned>::max();
+
+// Writes `value` at `first`, in fixed notation with `precision` digits after
+// the dot. Values that don't fit before `last` that way, and values without
+// precision, are written in the shortest round-trip form. There must be room
+// for `max_chars_in_floating_type<T>()` chars for it. Sets `*overflow`, if
+// given, when the value didn't fit with the precision.
+template <typename T>
+inline char* write_floating(char* first, char* last, T value,
+                            unsigned precision, bool* overflow = nullptr)
+{
+  if (precision != no_precision) {
+    const auto [ptr, ec] =
+      std::to_chars(first, last, value, std::chars_format::fixed,
+                    static_cast<int>(precision));
+    if (ec == std::errc{}) {
+      return ptr;
+    }
+    if (overflow != nullptr) {
+      *overflow = true;
+    }
+  }
+
+  return std::to_chars(first, last, value).ptr;
+}
+
+template <unsigned Precision, typename T>
+inline char* write_floating(char* first, char* last, T value,
+                            bool* overflow = nullptr)
+{
+  return write_floating(first, last, value, Precision, overflow);
+}
+
+// Moves already written chars [first, end) to the end of `length` chars slot
+// and fills the beginning. Returns pointer past the slot.
+inline char* move_to_slot_end(char* first, char* end, unsigned length,
+                              char fill)
+{
+  const auto size = static_cast<unsigned>(end - first);
+  const auto slot_end = std::next(first, length);
+
+  if (size != length) {
+    std::memmove(std::prev(slot_end, size), first, size);
+    std::memset(first, fill, length - size);
+  }
+
+  return slot_end;
+}
+
+// `move_to_slot_end` for numbers. With '0' fill, minus stays in front of the
+// zeros.
+inline char* align_right(char* first, char* end, unsigned length, char fill)
+{
+  const auto size = static_cast<unsigned>(end - first);
+  const auto slot_end = move_to_slot_end(first, end, length, fill);
+  const auto value_begin = std::prev(slot_end, size);
+
+  if (size != length && fill == '0' && *value_begin == '-') {
+    *value_begin = '0';
+    *first = '-';
   }
+
+  return slot_end;
+}
+
+template <unsigned Length>
+inline char* align_right(char* first, char* end, char fill)
+{
+  return align_right(first, end, Length, fill);
 }
 }
 
@@ -124,15 +700,116 @@ private:
   unsigned m_size{};
 };
 
+enum class param_align
+{
+  // No spec given. `set` writes only the value and leaves the rest of the
+  // slot untouched.
+  none,
+  // `{type:<}`. `set` writes the value at the beginning and fills the rest.
+  left,
+  // `{type:>}`. `set` writes the value at the end and fills the beginning.
+  right
+};
+
+template <param_align Align = param_align::none, char Fill = ' ',
+          unsigned Precision = no_precision, unsigned Base = 10u,
+          bool Uppercase = false>
+struct param_spec
+{
+  static constexpr auto align_v = Align;
+  static constexpr auto fill_v = Fill;
+  static constexpr auto precision_v = Precision;
+  static constexpr auto base_v = Base;
+  static constexpr auto uppercase_v = Uppercase;
+};
+
+struct format_spec
+{
+  param_align align{ param_align::none };
+  char fill{ ' ' };
+  // Minimal length of the param's slot. 0 if not given.
+  unsigned width{};
+  unsigned precision{ no_precision };
+  // Of integers. `x`, `X`, `o`, `b` or `d` type in the spec.
+  unsigned base{ 10u };
+  // Hex digits in upper case, `X` type.
+  bool uppercase{ false };
+};
+
+// Parses `[[fill]align][width][.precision][type]` where align is `<` or `>`
+// and type is `x`, `X`, `o`, `b` or `d`.
+constexpr format_spec parse_format_spec(std::string_view spec)
+{
+  const auto is_align = [](char c) { return c == '<' || c == '>'; };
+  const auto to_align = [](char c) {
+    return c == '<' ? param_align::left : param_align::right;
+  };
+  const auto digits_length = [](std::string_view s) {
+    const auto end =
+      find_if(s.cbegin(), s.cend(), [](char c) { return !is_digit(c); });
+    return static_cast<std::size_t>(end - s.cbegin());
+  };
+
+  format_spec result{};
+
+  if (spec.size() >= 2u && is_align(spec[1])) {
+    result.align = to_align(spec[1]);
+    result.fill = spec[0];
+    spec.remove_prefix(2u);
+  } else if (!spec.empty() && is_align(spec[0])) {
+    result.align = to_align(spec[0]);
+    spec.remove_prefix(1u);
+  }
+
+  const auto width_length = digits_length(spec);
+  result.width = stou(spec.substr(0u, width_length));
+  spec.remove_prefix(width_length);
+
+  if (!spec.empty() && spec[0] == '.') {
+    spec.remove_prefix(1u);
+    result.precision = stou(spec.substr(0u, digits_length(spec)));
+    spec.remove_prefix(digits_length(spec));
+  }
+
+  if (!spec.empty()) {
+    switch (spec[0]) {
+      case 'X':
+        result.uppercase = true;
+        result.base = 16u;
+        break;
+      case 'x':
+        result.base = 16u;
+        break;
+      case 'o':
+        result.base = 8u;
+        break;
+      case 'b':
+        result.base = 2u;
+        break;
+      default:
+        break;
+    }
+  }
+
+  return result;
+}
+
 template <typename T, unsigned PosInOriginal, unsigned PosInOutputBuffer,
-          unsigned Length, unsigned FormatSize>
+          unsigned Length, unsigned FormatSize,
+          typename Spec = param_spec<>>
 struct format_param
 {
   using type_t = T;
+  using spec_t = Spec;
   static constexpr auto pos_in_original_v = PosInOriginal;
   static constexpr auto pos_in_output_buffer_v = PosInOutputBuffer;
   static constexpr auto length_v = Length;
   static constexpr auto format_size_v = FormatSize;
+  static constexpr auto align_v = Spec::align_v;
+  static constexpr auto fill_v = Spec::fill_v;
+  static constexpr auto precision_v = Spec::precision_v;
+  static constexpr auto base_v = Spec::base_v;
+  static constexpr auto uppercase_v = Spec::uppercase_v;
 
   template <typename Buffer>
   static auto to_span(Buffer& buffer)
@@ -145,123 +822,314 @@ struct string_param
 {
 };
 
-template <typename... Ts>
-struct types
+// String that is JSON-escaped when written
+struct json_string_param
 {
 };
 
-enum class param_kind
+// Fixed-point decimal: mantissa of a value with the scale of the param
+struct decimal_param
 {
-  bool_,
-  char_,
-  signed_char,
-  unsigned_char,
-  short_int,
-  unsigned_short_int,
-  int_,
-  unsigned_int,
-  long_int,
-  unsigned_long_int,
-  long_long_int,
-  unsigned_long_long_int,
-  float_,
-  double_,
-  long_double,
-  uint8,
-  int8,
-  uint16,
-  int16,
-  uint32,
-  int32,
-  uint64,
-  int64,
-  str
-};
+  constexpr decimal_param(std::int64_t value)
+    : mantissa{ value }
+  {
+  }
 
-constexpr std::optional<param_kind> format_str_to_kind(std::string_view s)
+  std::int64_t mantissa;
+};
+
+// Nanoseconds since the Unix epoch, written as UTC ISO-8601 timestamp
+struct timestamp_param
 {
-  if (s.substr(0, 4u) == "{str") {
-    return param_kind::str;
-  }
-  if (s == "{bool}") {
-    return param_kind::bool_;
-  }
-  if (s == "{char}") {
-    return param_kind::char_;
-  }
-  if (s == "{signed char}") {
-    return param_kind::signed_char;
+  constexpr timestamp_param(std::int64_t nanoseconds)
+    : ns{ nanoseconds }
+  {
   }
-  if (s == "{unsigned char}") {
-    return param_kind::unsigned_char;
+
+  template <typename Clock, typename Duration>
+  constexpr timestamp_param(std::chrono::time_point<Clock, Duration> time)
+    : ns{ std::chrono::duration_cast<std::chrono::nanoseconds>(
+            time.time_since_epoch())
+            .count() }
+  {
   }
-  // Todo measure whether compilation time decreases whether `ifs` for
-  // uncommonly used types (like signed) are moved to the end of function
-  if (s == "{short}" || s == "{short int}" || s == "{signed short}" ||
-      s == "{signed short int}") {
-    return param_kind::short_int;
+
+  std::int64_t ns;
+};
+
+// Length of a part of the message, `{len:FROM..TO}`. The formatter keeps its
+// value up to date, it's not set by the user.
+struct length_param
+{
+};
+
+// Position in the message, `{name:mark}`, e.g. an end of a length param's
+// range. It takes no chars.
+struct mark_param
+{
+};
+
+// FIX CheckSum, `{fixsum:FROM..TO}`: sum of the bytes of a part of the
+// message, modulo 256, written as 3 digits. Kept up to date like lengths.
+struct fix_checksum_param
+{
+};
+
+// CRC-32C of a part of the message, `{crc32c:FROM..TO}`, written as 8 hex
+// digits. Kept up to date like lengths.
+struct crc32c_param
+{
+};
+
+template <typename T>
+inline constexpr bool is_checksum_param_v =
+  std::is_same_v<T, fix_checksum_param> || std::is_same_v<T, crc32c_param>;
+
+// Params that can't be set
+template <typename T>
+inline constexpr bool is_derived_param_v =
+  std::is_same_v<T, length_param> || std::is_same_v<T, mark_param> ||
+  is_checksum_param_v<T>;
+
+template <typename T>
+inline constexpr bool is_string_param_v =
+  std::is_same_v<T, string_param> || std::is_same_v<T, json_string_param>;
+
+template <typename... Ts>
+struct types
+{
+};
+
+template <typename Option, typename... Options>
+constexpr bool has_option(types<Options...>)
+{
+  return (std::is_same_v<Option, Options> || ...);
+}
+
+enum class param_kind
+{
+  bool_,
+  char_,
+  signed_char,
+  unsigned_char,
+  short_int,
+  unsigned_short_int,
+  int_,
+  unsigned_int,
+  long_int,
+  unsigned_long_int,
+  long_long_int,
+  unsigned_long_long_int,
+  float_,
+  double_,
+  long_double,
+  uint8,
+  int8,
+  uint16,
+  int16,
+  uint32,
+  int32,
+  uint64,
+  int64,
+  str,
+  jstr,
+  timestamp_ns,
+  dec64,
+  len,
+  mark,
+  fixsum,
+  crc32c
+};
+
+// Name of the type in a format parameter, e.g. `uint32_t` in `{uint32_t:>}`
+constexpr std::string_view param_type_name(std::string_view s)
+{
+  const auto begin = std::next(s.cbegin());
+  const auto end = find_if(begin, s.cend(),
+                           [](char c) { return c == ':' || c == '}'; });
+  return s.substr(1u, static_cast<std::size_t>(end - begin));
+}
+
+// Range of a length or checksum param, e.g. `body..end` in
+// `{len:body..end:>}`
+constexpr std::string_view length_range_string(std::string_view s)
+{
+  const auto colon = find(std::next(s.cbegin()), s.cend(), ':');
+  if (colon == s.cend()) {
+    return {};
   }
-  if (s == "{unsigned short}" || s == "{unsigned short int}") {
-    return param_kind::unsigned_short_int;
+
+  const auto begin = std::next(colon);
+  const auto end =
+    find_if(begin, s.cend(), [](char c) { return c == ':' || c == '}'; });
+  return s.substr(static_cast<std::size_t>(begin - s.cbegin()),
+                  static_cast<std::size_t>(end - begin));
+}
+
+// Whether `s` is a length or checksum param with a range, e.g. `{len:0..3}`.
+// In `{len:uint32_t}` the text after the colon isn't a range, so `len` is a
+// name. Without a range, e.g. in `{len}`, it's still a length param, so that
+// the missing range is reported.
+constexpr bool has_range(std::string_view s)
+{
+  const auto type_name = param_type_name(s);
+  if (!equals(type_name, "len") && !equals(type_name, "fixsum") &&
+      !equals(type_name, "crc32c")) {
+    return false;
   }
-  if (s == "{int}" || s == "{signed}" || s == "{signed int}") {
-    return param_kind::int_;
+
+  const auto range = length_range_string(s);
+  for (auto i = 0u; i + 1u < range.size(); ++i) {
+    if (range[i] == '.' && range[i + 1u] == '.') {
+      return true;
+    }
   }
-  if (s == "{unsigned}" || s == "{unsigned int}") {
-    return param_kind::unsigned_int;
+
+  return range.empty();
+}
+
+// Spec of a format parameter, e.g. `0>` in `{uint32_t:0>}`. Empty if there is
+// no spec.
+constexpr std::string_view param_spec_string(std::string_view s)
+{
+  auto colon = find(std::next(s.cbegin()), s.cend(), ':');
+  if (colon != s.cend()) {
+    // Range of a length or checksum param goes before the spec, e.g.
+    // `{len:0..3:>}`
+    if (has_range(s)) {
+      colon = find(std::next(colon), s.cend(), ':');
+    }
   }
-  if (s == "{long}" || s == "{long int}" || s == "{signed long}" ||
-      s == "{signed long int}") {
-    return param_kind::long_int;
+  if (colon == s.cend()) {
+    return {};
   }
-  if (s == "{unsigned long}" || s == "{unsigned long int}") {
-    return param_kind::unsigned_long_int;
+
+  const auto begin = std::next(colon);
+  const auto end = find(begin, s.cend(), '}');
+  return s.substr(static_cast<std::size_t>(begin - s.cbegin()),
+                  static_cast<std::size_t>(end - begin));
+}
+
+constexpr std::optional<param_kind> format_str_to_kind(std::string_view s)
+{
+  const auto name = param_type_name(s);
+
+  // Commonly used types are checked first. It makes compilation of big format
+  // strings noticeably faster. Names of named params can start like a type,
+  // e.g. `strike`, so the width or scale must be a number.
+  if (starts_with(name, "str") && is_number(name.substr(3u))) {
+    return param_kind::str;
   }
-  if (s == "{long long}" || s == "{long long int}" ||
-      s == "{signed long long}" || s == "{signed long long int}") {
-    return param_kind::long_long_int;
+  if (starts_with(name, "jstr") && is_number(name.substr(4u))) {
+    return param_kind::jstr;
   }
-  if (s == "{unsigned long long}" || s == "{unsigned long long int}") {
-    return param_kind::unsigned_long_long_int;
+  if (equals(name, "timestamp_ns")) {
+    return param_kind::timestamp_ns;
   }
-  if (s == "{float}") {
-    return param_kind::float_;
+  if (equals(name, "dec64") ||
+      (starts_with(name, "dec64.") && is_number(name.substr(6u)))) {
+    return param_kind::dec64;
   }
-  if (s == "{double}") {
-    return param_kind::double_;
+  if (has_range(s)) {
+    if (equals(name, "len")) {
+      return param_kind::len;
+    }
+    if (equals(name, "fixsum")) {
+      return param_kind::fixsum;
+    }
+    return param_kind::crc32c;
   }
-  if (s == "{long double}") {
-    return param_kind::long_double;
+  if (equals(name, "mark")) {
+    return param_kind::mark;
   }
-  if (s == "{uint8_t}") {
+  if (equals(name, "uint8_t")) {
     return param_kind::uint8;
   }
-  if (s == "{int8_t}") {
+  if (equals(name, "int8_t")) {
     return param_kind::int8;
   }
-  if (s == "{uint16_t}") {
+  if (equals(name, "uint16_t")) {
     return param_kind::uint16;
   }
-  if (s == "{int16_t}") {
+  if (equals(name, "int16_t")) {
     return param_kind::int16;
   }
-  if (s == "{uint32_t}") {
+  if (equals(name, "uint32_t")) {
     return param_kind::uint32;
   }
-  if (s == "{int32_t}") {
+  if (equals(name, "int32_t")) {
     return param_kind::int32;
   }
-  if (s == "{uint64_t}") {
+  if (equals(name, "uint64_t")) {
     return param_kind::uint64;
   }
-  if (s == "{int64_t}") {
+  if (equals(name, "int64_t")) {
     return param_kind::int64;
   }
+  if (equals(name, "bool")) {
+    return param_kind::bool_;
+  }
+  if (equals(name, "double")) {
+    return param_kind::double_;
+  }
+  if (equals(name, "float")) {
+    return param_kind::float_;
+  }
+  if (equals(name, "long double")) {
+    return param_kind::long_double;
+  }
+  if (equals(name, "char")) {
+    return param_kind::char_;
+  }
+  if (equals(name, "signed char")) {
+    return param_kind::signed_char;
+  }
+  if (equals(name, "unsigned char")) {
+    return param_kind::unsigned_char;
+  }
+  if (equals(name, "short") || equals(name, "short int") ||
+      equals(name, "signed short") || equals(name, "signed short int")) {
+    return param_kind::short_int;
+  }
+  if (equals(name, "unsigned short") || equals(name, "unsigned short int")) {
+    return param_kind::unsigned_short_int;
+  }
+  if (equals(name, "int") || equals(name, "signed") ||
+      equals(name, "signed int")) {
+    return param_kind::int_;
+  }
+  if (equals(name, "unsigned") || equals(name, "unsigned int")) {
+    return param_kind::unsigned_int;
+  }
+  if (equals(name, "long") || equals(name, "long int") ||
+      equals(name, "signed long") || equals(name, "signed long int")) {
+    return param_kind::long_int;
+  }
+  if (equals(name, "unsigned long") || equals(name, "unsigned long int")) {
+    return param_kind::unsigned_long_int;
+  }
+  if (equals(name, "long long") || equals(name, "long long int") ||
+      equals(name, "signed long long") ||
+      equals(name, "signed long long int")) {
+    return param_kind::long_long_int;
+  }
+  if (equals(name, "unsigned long long") ||
+      equals(name, "unsigned long long int")) {
+    return param_kind::unsigned_long_long_int;
+  }
 
   return std::nullopt;
 }
 
-constexpr unsigned max_length_of(param_kind kind, std::string_view s)
+// Digits after the dot of a `dec64.N` param, `N`. 0 for `dec64`.
+constexpr unsigned decimal_scale(std::string_view type_name)
+{
+  return type_name.size() > 6u ? stou(type_name.substr(6u)) : 0u;
+}
+
+// Length of the longest value of the param's type
+constexpr unsigned max_value_length_of(param_kind kind, std::string_view s,
+                                       unsigned base)
 {
   switch (kind) {
     case param_kind::bool_: {
@@ -269,37 +1137,37 @@ constexpr unsigned max_length_of(param_kind kind, std::string_view s)
       return 5u;
     }
     case param_kind::char_: {
-      return max_chars_in_type<char>();
+      return max_chars_in_type<char>(base);
     }
     case param_kind::signed_char: {
-      return max_chars_in_type<signed char>();
+      return max_chars_in_type<signed char>(base);
     }
     case param_kind::unsigned_char: {
-      return max_chars_in_type<unsigned char>();
+      return max_chars_in_type<unsigned char>(base);
     }
     case param_kind::short_int: {
-      return max_chars_in_type<short int>();
+      return max_chars_in_type<short int>(base);
     }
     case param_kind::unsigned_short_int: {
-      return max_chars_in_type<unsigned short int>();
+      return max_chars_in_type<unsigned short int>(base);
     }
     case param_kind::int_: {
-      return max_chars_in_type<int>();
+      return max_chars_in_type<int>(base);
     }
     case param_kind::unsigned_int: {
-      return max_chars_in_type<unsigned int>();
+      return max_chars_in_type<unsigned int>(base);
     }
     case param_kind::long_int: {
-      return max_chars_in_type<long int>();
+      return max_chars_in_type<long int>(base);
     }
     case param_kind::unsigned_long_int: {
-      return max_chars_in_type<unsigned long int>();
+      return max_chars_in_type<unsigned long int>(base);
     }
     case param_kind::long_long_int: {
-      return max_chars_in_type<long long int>();
+      return max_chars_in_type<long long int>(base);
     }
     case param_kind::unsigned_long_long_int: {
-      return max_chars_in_type<unsigned long long int>();
+      return max_chars_in_type<unsigned long long int>(base);
     }
     case param_kind::float_: {
       return max_chars_in_floating_type<float>();
@@ -311,330 +1179,3206 @@ constexpr unsigned max_length_of(param_kind kind, std::string_view s)
       return max_chars_in_floating_type<long double>();
     }
     case param_kind::uint8: {
-      return max_chars_in_type<std::uint8_t>();
+      return max_chars_in_type<std::uint8_t>(base);
     }
     case param_kind::int8: {
-      return max_chars_in_type<std::int8_t>();
+      return max_chars_in_type<std::int8_t>(base);
     }
     case param_kind::uint16: {
-      return max_chars_in_type<std::uint16_t>();
+      return max_chars_in_type<std::uint16_t>(base);
     }
     case param_kind::int16: {
-      return max_chars_in_type<std::int16_t>();
+      return max_chars_in_type<std::int16_t>(base);
     }
     case param_kind::uint32: {
-      return max_chars_in_type<std::uint32_t>();
+      return max_chars_in_type<std::uint32_t>(base);
     }
     case param_kind::int32: {
-      return max_chars_in_type<std::int32_t>();
+      return max_chars_in_type<std::int32_t>(base);
     }
     case param_kind::uint64: {
-      return max_chars_in_type<std::uint64_t>();
+      return max_chars_in_type<std::uint64_t>(base);
     }
     case param_kind::int64: {
-      return max_chars_in_type<std::int64_t>();
+      return max_chars_in_type<std::int64_t>(base);
     }
     case param_kind::str: {
-      const auto end_pos = s.find('}');
-      const auto number_subs = s.substr(4, end_pos - 4);
-      return stou(number_subs);
+      return stou(param_type_name(s).substr(3u));
+    }
+    case param_kind::jstr: {
+      return stou(param_type_name(s).substr(4u));
+    }
+    case param_kind::timestamp_ns: {
+      // YYYY-MM-DDTHH:MM:SS.nnnnnnnnnZ
+      return 30u;
+    }
+    case param_kind::dec64: {
+      // Minus, integer digits (at least `0`), dot and the fraction
+      constexpr auto digits = max_chars_in_type<std::int64_t>() - 1u;
+      const auto scale = decimal_scale(param_type_name(s));
+      return 1u + std::max(digits - std::min(scale, digits), 1u) +
+             (scale > 0u ? 1u + scale : 0u);
+    }
+    case param_kind::len: {
+      return max_chars_in_type<std::uint32_t>(base);
+    }
+    case param_kind::mark: {
+      return 0u;
+    }
+    case param_kind::fixsum: {
+      return 3u;
+    }
+    case param_kind::crc32c: {
+      return 8u;
     }
   }
+
+  // Not a kind
+  return 0u;
 }
 
-constexpr unsigned max_length_of(std::string_view s)
+constexpr unsigned max_length_of(param_kind kind, std::string_view s)
 {
-  const auto kind = format_str_to_kind(s);
+  const auto spec = parse_format_spec(param_spec_string(s));
+  auto length =
+    std::max(max_value_length_of(kind, s, spec.base), spec.width);
 
-  if (kind == std::nullopt) {
-    // Handle properly
-    return 0;
+  const auto is_floating = kind == param_kind::float_ ||
+                           kind == param_kind::double_ ||
+                           kind == param_kind::long_double;
+  if (is_floating && spec.precision != no_precision) {
+    // At least room for `-0.` and the fractional digits
+    length = std::max(length, spec.precision + 3u);
   }
 
-  return max_length_of(*kind, s);
+  return length;
 }
 
-template <unsigned CurrentPos, unsigned CurrentSize = 0u, typename S>
-constexpr auto format_param_from(S)
+// Param string without the name of a named param, with its kind and the
+// name. E.g. for `{seq_no:uint64_t:>}` it's `:uint64_t:>}`, so that like
+// every param string, its first char is not a part of the type.
+struct typed_param
 {
-  constexpr auto subs = S::substr(CurrentPos);
-  constexpr auto format_length = subs.find('}') + 1u;
-  constexpr auto param_format_string = S::substr(CurrentPos, format_length);
-  constexpr auto kind = format_str_to_kind(param_format_string);
-  if constexpr (kind == std::nullopt) {
-    // Todo: handle properly
-    return true;
+  std::optional<param_kind> kind{};
+  std::string_view param{};
+  std::string_view name{};
+};
+
+// A param is named when the text before the first colon isn't a type.
+constexpr typed_param parse_typed_param(std::string_view s)
+{
+  if (const auto kind = format_str_to_kind(s)) {
+    return { kind, s, {} };
   }
 
-  constexpr auto max_length = max_length_of(*kind, param_format_string);
-
-  if constexpr (kind == param_kind::uint8) {
-    return format_param<std::uint8_t, CurrentPos, CurrentSize, max_length,
-                        format_length>{};
-  } else if constexpr (kind == param_kind::int8) {
-    return format_param<std::int8_t, CurrentPos, CurrentSize, max_length,
-                        format_length>{};
-  } else if constexpr (kind == param_kind::uint16) {
-    return format_param<std::uint16_t, CurrentPos, CurrentSize, max_length,
-                        format_length>{};
-  } else if constexpr (kind == param_kind::int16) {
-    return format_param<std::int16_t, CurrentPos, CurrentSize, max_length,
-                        format_length>{};
-  } else if constexpr (kind == param_kind::uint32) {
-    return format_param<std::uint32_t, CurrentPos, CurrentSize, max_length,
-                        format_length>{};
-  } else if constexpr (kind == param_kind::int32) {
-    return format_param<std::int32_t, CurrentPos, CurrentSize, max_length,
-                        format_length>{};
-  } else if constexpr (kind == param_kind::uint64) {
-    return format_param<std::uint64_t, CurrentPos, CurrentSize, max_length,
-                        format_length>{};
-  } else if constexpr (kind == param_kind::int64) {
-    return format_param<std::int64_t, CurrentPos, CurrentSize, max_length,
-                        format_length>{};
-  } else if constexpr (kind == param_kind::str) {
-    return format_param<string_param, CurrentPos, CurrentSize, max_length,
-                        format_length>{};
-  } else {
-    return true;
+  const auto colon = find(std::next(s.cbegin()), s.cend(), ':');
+  if (colon == s.cend()) {
+    return { std::nullopt, s, {} };
   }
+
+  const auto colon_pos = static_cast<std::size_t>(colon - s.cbegin());
+  const auto typed = s.substr(colon_pos);
+  return { format_str_to_kind(typed), typed, s.substr(1u, colon_pos - 1u) };
 }
-constexpr auto calc_size(std::string_view s)
+
+constexpr unsigned max_length_of(std::string_view s)
 {
-  auto size = 0u;
+  const auto typed = parse_typed_param(s);
 
-  for (auto i = 0u; i < s.size();) {
-    const auto c = s[i];
+  if (typed.kind == std::nullopt) {
+    // Handle properly
+    return 0;
+  }
 
-    if (c == '}') {
-      // Found ending brace without begin brace. Next char can only be another
-      // ending brace.
-      if (i + 1u >= s.size()) {
-        // Todo report malformed format stirng. } without {
-      }
+  return max_length_of(*typed.kind, typed.param);
+}
 
-      if (s[i + 1u] != '}') {
-        // Todo report malformed format stirng. } without {
-      }
+template <typename T>
+struct type_tag
+{
+  using type = T;
+};
 
-      // Got }}. Treat it as one char } in output string
-      ++size;
-      i += 2u; // Omit both }}
-      continue;
-    }
+// Type of values of a param of the given kind
+template <param_kind Kind>
+constexpr auto kind_type_tag()
+{
+  if constexpr (Kind == param_kind::bool_) {
+    return type_tag<bool>{};
+  } else if constexpr (Kind == param_kind::char_) {
+    return type_tag<char>{};
+  } else if constexpr (Kind == param_kind::signed_char) {
+    return type_tag<signed char>{};
+  } else if constexpr (Kind == param_kind::unsigned_char) {
+    return type_tag<unsigned char>{};
+  } else if constexpr (Kind == param_kind::short_int) {
+    return type_tag<short int>{};
+  } else if constexpr (Kind == param_kind::unsigned_short_int) {
+    return type_tag<unsigned short int>{};
+  } else if constexpr (Kind == param_kind::int_) {
+    return type_tag<int>{};
+  } else if constexpr (Kind == param_kind::unsigned_int) {
+    return type_tag<unsigned int>{};
+  } else if constexpr (Kind == param_kind::long_int) {
+    return type_tag<long int>{};
+  } else if constexpr (Kind == param_kind::unsigned_long_int) {
+    return type_tag<unsigned long int>{};
+  } else if constexpr (Kind == param_kind::long_long_int) {
+    return type_tag<long long int>{};
+  } else if constexpr (Kind == param_kind::unsigned_long_long_int) {
+    return type_tag<unsigned long long int>{};
+  } else if constexpr (Kind == param_kind::float_) {
+    return type_tag<float>{};
+  } else if constexpr (Kind == param_kind::double_) {
+    return type_tag<double>{};
+  } else if constexpr (Kind == param_kind::long_double) {
+    return type_tag<long double>{};
+  } else if constexpr (Kind == param_kind::uint8) {
+    return type_tag<std::uint8_t>{};
+  } else if constexpr (Kind == param_kind::int8) {
+    return type_tag<std::int8_t>{};
+  } else if constexpr (Kind == param_kind::uint16) {
+    return type_tag<std::uint16_t>{};
+  } else if constexpr (Kind == param_kind::int16) {
+    return type_tag<std::int16_t>{};
+  } else if constexpr (Kind == param_kind::uint32) {
+    return type_tag<std::uint32_t>{};
+  } else if constexpr (Kind == param_kind::int32) {
+    return type_tag<std::int32_t>{};
+  } else if constexpr (Kind == param_kind::uint64) {
+    return type_tag<std::uint64_t>{};
+  } else if constexpr (Kind == param_kind::int64) {
+    return type_tag<std::int64_t>{};
+  } else if constexpr (Kind == param_kind::jstr) {
+    return type_tag<json_string_param>{};
+  } else if constexpr (Kind == param_kind::timestamp_ns) {
+    return type_tag<timestamp_param>{};
+  } else if constexpr (Kind == param_kind::dec64) {
+    return type_tag<decimal_param>{};
+  } else if constexpr (Kind == param_kind::len) {
+    return type_tag<length_param>{};
+  } else if constexpr (Kind == param_kind::mark) {
+    return type_tag<mark_param>{};
+  } else if constexpr (Kind == param_kind::fixsum) {
+    return type_tag<fix_checksum_param>{};
+  } else if constexpr (Kind == param_kind::crc32c) {
+    return type_tag<crc32c_param>{};
+  } else {
+    return type_tag<string_param>{};
+  }
+}
 
-    if (c == '{') {
-      // Two possibilities - {{ or a format parameter
+enum class token_kind
+{
+  plain,
+  // {{ or }}
+  escaped_brace,
+  param
+};
 
-      if (i + 1u >= s.size()) {
-        // Todo report malformed format string. A single { at the end of format
-        // string
-      }
+// A run of plain text, an escaped brace or a param of a format string
+struct format_token
+{
+  token_kind kind{ token_kind::plain };
+  // Position and size in the format string
+  unsigned pos{};
+  unsigned size{};
+  // Number of chars in the output buffer. Not computed for params, because
+  // it requires parsing the param.
+  unsigned length{};
+};
 
-      if (s[i + 1u] == '{') {
-        // Got {{. Treat it as one char { in output string
-        ++size;
-        i += 2u; // Omit both {{
-        continue;
-      }
+// Token that begins at `pos` of format string `s`. Format strings are parsed
+// with a loop over tokens, so the parsing doesn't need a template
+// instantiation per param.
+constexpr format_token next_token(std::string_view s, unsigned pos)
+{
+  const auto c = s[pos];
 
-      // Should be a format parameter
+  if (c != '{' && c != '}') {
+    const auto begin = std::next(s.cbegin(), pos);
+    const auto end = find_if(begin, s.cend(),
+                             [](char c) { return c == '{' || c == '}'; });
+    const auto size = static_cast<unsigned>(end - begin);
+    return { token_kind::plain, pos, size, size };
+  }
 
-      const auto begin_pos = i;
+  if (pos + 1u < s.size() && s[pos + 1u] == c) {
+    // Got {{ or }}. Treat it as one char in output string
+    return { token_kind::escaped_brace, pos, 2u, 1u };
+  }
 
-      const auto end_pos = s.find('}', begin_pos);
-      if (end_pos == std::string_view::npos) {
-        // Todo report malformed format parameter. { without }
-      }
+  // Should be a format parameter. A single } and { without } end up as
+  // params of unknown kind.
+  const auto begin = std::next(s.cbegin(), pos);
+  const auto end = find(begin, s.cend(), '}');
+  const auto size = static_cast<unsigned>(end - begin) + (end != s.cend());
+  return { token_kind::param, pos, size, 0u };
+}
 
-      const auto subs = s.substr(begin_pos, end_pos - begin_pos + 1u);
-      size += max_length_of(subs);
-      i = end_pos + 1u;
-      continue;
-    }
+constexpr unsigned calc_size(std::string_view s)
+{
+  auto size = 0u;
 
-    // Got a regular char.
-    ++size;
-    ++i;
+  for (auto pos = 0u; pos < s.size();) {
+    const auto token = next_token(s, pos);
+    size += token.kind == token_kind::param
+              ? max_length_of(s.substr(pos, token.size))
+              : token.length;
+    pos += token.size;
   }
 
   return size;
 }
 
-template <typename S, std::string_view::size_type FullLength, typename Params>
-struct format_info
+constexpr unsigned count_params(std::string_view s)
 {
-  using format_t = S;
-  static constexpr auto full_length_v = FullLength;
-  using params_t = Params;
-};
+  auto count = 0u;
 
-template <std::string_view::size_type CurrentPos,
-          std::string_view::size_type CurrentSize = 0u, typename S,
-          typename... Params>
-constexpr auto collect_format_info(S, Params... params)
-{
-  constexpr auto current = S::substr(CurrentPos);
-  constexpr auto begin_pos = current.find('{');
-  constexpr auto end_brace_begin_pos = current.find('}');
-  if constexpr (end_brace_begin_pos != std::string_view::npos &&
-                end_brace_begin_pos < begin_pos) {
-    if constexpr (current[end_brace_begin_pos + 1u] == '}') {
-      return collect_format_info<CurrentPos + end_brace_begin_pos + 2,
-                                 CurrentSize + 2>(S{}, params...);
-    }
-  } else if constexpr (begin_pos == std::string_view::npos) {
-    return format_info<S, CurrentSize + current.size(), types<Params...>>{};
-  } else if constexpr (current[begin_pos + 1u] == '{') {
-    return collect_format_info<CurrentPos + begin_pos + 2, CurrentSize + 2>(
-      S{}, params...);
-  } else {
-    constexpr auto end_pos = current.find('}', begin_pos);
-    constexpr auto subs =
-      S::substr(CurrentPos + begin_pos,
-                CurrentPos + end_pos + std::string_view::size_type{ 1 });
-    constexpr auto param =
-      format_param_from<CurrentPos + begin_pos, CurrentSize + begin_pos>(S{});
-    return collect_format_info<CurrentPos + end_pos + 1u,
-                               CurrentSize + begin_pos + param.length_v>(
-      S{}, params..., param);
+  for (auto pos = 0u; pos < s.size();) {
+    const auto token = next_token(s, pos);
+    count += token.kind == token_kind::param;
+    pos += token.size;
   }
+
+  return count;
 }
 
-template <typename S, typename Buffer, typename... Params>
-constexpr auto fill_buffer(Buffer& buffer, types<Params...>)
+struct param_descriptor
 {
-  constexpr auto s = S::to_string_view();
-  auto current_original = s.cbegin();
-  auto current_buffer = buffer.begin();
-
-  const auto copy_plain_string = [&](auto begin, auto end) {
-    // Include end
-    while (begin != end) {
-      ++begin;
+  std::optional<param_kind> kind{};
+  unsigned pos_in_original{};
+  unsigned pos_in_output_buffer{};
+  unsigned length{};
+  unsigned format_size{};
+  format_spec spec{};
+  // Empty for unnamed params
+  std::string_view name{};
+};
 
-      // Copy plain char
-      *current_buffer++ = *current_original++;
+// Describes param that begins at `pos` of format string `s`
+constexpr param_descriptor describe_param(std::string_view s, unsigned pos,
+                                          unsigned pos_in_output_buffer)
+{
+  const auto token = next_token(s, pos);
+  const auto typed = parse_typed_param(s.substr(pos, token.size));
+  const auto kind = typed.kind;
+  const auto param_string = typed.param;
+  auto spec = parse_format_spec(param_spec_string(param_string));
 
-      if (begin == end) {
-        break;
-      }
+  if (kind == param_kind::dec64) {
+    // Scale of decimals is carried as precision
+    spec.precision = decimal_scale(param_type_name(param_string));
+  }
 
-      // We had {{ or }} in plain text. Omit the second char
-      if (*current_original == '{' || *current_original == '}') {
-        ++current_original;
-      }
-    }
-  };
+  return { kind,
+           pos,
+           pos_in_output_buffer,
+           kind ? max_length_of(*kind, param_string) : 0u,
+           token.size,
+           spec,
+           typed.name };
+}
 
-  auto filling_impl = [&](auto param) {
-    const auto param_begin_in_original_it =
-      std::next(s.cbegin(), param.pos_in_original_v);
-
-    // Copy plain string that's before parameter
-    const auto plain_begin = current_original;
-    const auto plain_end = param_begin_in_original_it;
-    copy_plain_string(plain_begin, plain_end);
-
-    // Fill param place with spaces
-    const auto param_begin = current_buffer;
-    const auto param_end = std::next(current_buffer, param.length_v);
-    fill(param_begin, param_end, ' ');
-    std::advance(current_original, param.format_size_v);
-    std::advance(current_buffer, param.length_v);
-  };
+template <unsigned ParamsCount>
+struct params_layout
+{
+  std::array<param_descriptor, ParamsCount> params{};
+  unsigned full_length{};
+};
 
-  auto filler = [&](auto... params) { (filling_impl(params), ...); };
-  filler(Params{}...);
+// Descriptors of all params of `s` and length of the output buffer, found in
+// a single pass. Every param is parsed once.
+template <unsigned ParamsCount>
+constexpr auto describe_params(std::string_view s)
+{
+  params_layout<ParamsCount> layout{};
+  auto current = 0u;
 
-  // Fill last part of plain
-  copy_plain_string(current_original, s.cend());
-}
+  for (auto pos = 0u; pos < s.size();) {
+    const auto token = next_token(s, pos);
 
-template <typename S>
-constexpr auto make_buffer(S)
-{
-  constexpr auto info = collect_format_info<0u, 0u>(S{});
-  std::array<char, info.full_length_v> buffer{};
+    if (token.kind == token_kind::param) {
+      const auto param = describe_param(s, pos, layout.full_length);
+      layout.params[current++] = param;
+      layout.full_length += param.length;
+    } else {
+      layout.full_length += token.length;
+    }
 
-  fill_buffer<S>(buffer, typename decltype(info)::params_t{});
+    pos += token.size;
+  }
 
-  return buffer;
+  return layout;
 }
 
-template <typename S, typename... Params>
-class formatter
+// Layout of the output buffer of format string `S`. Computed once per format
+// string.
+template <typename S>
+struct format_layout
 {
-public:
-  constexpr formatter() = default;
+  static constexpr auto params_count_v = count_params(S::to_string_view());
+  static constexpr auto layout_v =
+    describe_params<params_count_v>(S::to_string_view());
+  static constexpr auto& params_v = layout_v.params;
+  static constexpr auto full_length_v = layout_v.full_length;
 
-  template <unsigned N, typename Value>
-  auto set(const Value& val)
+  static constexpr bool all_params_known()
   {
-    using param_t = std::decay_t<decltype(std::get<N>(m_params))>;
-    const auto param_buf = param_t::to_span(m_buffer);
-    const auto [ptr, ec] =
-      std::to_chars(param_buf.begin(), param_buf.end(), val);
-    return ptr;
+    for (const auto& param : params_v) {
+      if (!param.kind) {
+        return false;
+      }
+    }
+    return true;
   }
 
-  template <unsigned N>
-  auto set(std::string_view value)
+  // Index of the param named `name`, or `params_count_v` if there is none.
+  static constexpr unsigned index_of(std::string_view name)
   {
-    using param_t = std::decay_t<decltype(std::get<N>(m_params))>;
-    const auto param_buf = param_t::to_span(m_buffer);
-    std::copy(value.cbegin(), value.cend(), param_buf.begin());
-    return std::next(param_buf.begin(), value.size());
+    for (auto n = 0u; n < params_count_v; ++n) {
+      if (!name.empty() && equals(params_v[n].name, name)) {
+        return n;
+      }
+    }
+    return params_count_v;
   }
 
-  template <unsigned N, typename Value>
-  void set_with_fill(const Value& val, char fill)
+  static constexpr bool names_unique()
   {
-    using param_t = std::decay_t<decltype(std::get<N>(m_params))>;
-    const auto param_buf = param_t::to_span(m_buffer);
-    const auto [ptr, ec] =
-      std::to_chars(param_buf.begin(), param_buf.end(), val);
-    std::fill(ptr, param_buf.end(), fill);
+    for (auto n = 0u; n < params_count_v; ++n) {
+      const auto& name = params_v[n].name;
+      if (!name.empty() && index_of(name) != n) {
+        return false;
+      }
+    }
+    return true;
   }
+};
 
-  template <unsigned N, typename Value>
-  void set_with_fill_hint(const Value& val, char fill, char* max_fill_hint)
-  {
-    using param_t = std::decay_t<decltype(std::get<N>(m_params))>;
-    const auto param_buf = param_t::to_span(m_buffer);
-    const auto [ptr, ec] =
-      std::to_chars(param_buf.begin(), param_buf.end(), val);
+// `format_param` type described by `Descriptor::value()`, or `true` if the
+// param is of unknown kind.
+template <typename Descriptor>
+constexpr auto format_param_for()
+{
+  constexpr auto d = Descriptor::value();
 
-    if (ptr < max_fill_hint) {
+  if constexpr (!d.kind) {
+    // Todo: handle properly
+    return true;
+  } else {
+    using type_t = typename decltype(kind_type_tag<*d.kind>())::type;
+    using spec_t = param_spec<d.spec.align, d.spec.fill, d.spec.precision,
+                              d.spec.base, d.spec.uppercase>;
+    return format_param<type_t, d.pos_in_original, d.pos_in_output_buffer,
+                        d.length, d.format_size, spec_t>{};
+  }
+}
+
+template <typename S, unsigned PosInOriginal, unsigned PosInOutputBuffer>
+struct param_at_descriptor
+{
+  static constexpr param_descriptor value()
+  {
+    return describe_param(S::to_string_view(), PosInOriginal,
+                          PosInOutputBuffer);
+  }
+};
+
+template <typename S, unsigned N>
+struct layout_descriptor
+{
+  static constexpr param_descriptor value()
+  {
+    return format_layout<S>::params_v[N];
+  }
+};
+
+// Type of the `N`th param of format string `S`
+template <typename S, unsigned N>
+using layout_param_t = decltype(format_param_for<layout_descriptor<S, N>>());
+
+template <unsigned CurrentPos, unsigned CurrentSize = 0u, typename S>
+constexpr auto format_param_from(S)
+{
+  return format_param_for<param_at_descriptor<S, CurrentPos, CurrentSize>>();
+}
+
+template <typename S, std::string_view::size_type FullLength, typename Params>
+struct format_info
+{
+  using format_t = S;
+  static constexpr auto full_length_v = FullLength;
+  using params_t = Params;
+};
+
+template <typename S, std::size_t... Ns>
+constexpr auto collect_format_info_impl(std::index_sequence<Ns...>)
+{
+  return format_info<S, format_layout<S>::full_length_v,
+                     types<layout_param_t<S, Ns>...>>{};
+}
+
+template <typename S>
+constexpr auto collect_format_info(S)
+{
+  static_assert(format_layout<S>::all_params_known(),
+                "Unknown param in the format string");
+  static_assert(format_layout<S>::names_unique(),
+                "Param names in the format string must be unique");
+  return collect_format_info_impl<S>(
+    std::make_index_sequence<format_layout<S>::params_count_v>{});
+}
+
+// Copies plain text of `s` to `buffer` and fills space of `params` with
+// their fill chars.
+template <typename Params, typename Buffer>
+constexpr void fill_buffer(std::string_view s, const Params& params,
+                           Buffer& buffer)
+{
+  auto current_buffer = buffer.begin();
+  auto current_param = params.begin();
+
+  for (auto pos = 0u; pos < s.size();) {
+    const auto token = next_token(s, pos);
+
+    if (token.kind == token_kind::param) {
+      const auto buffer_end = std::next(current_buffer, current_param->length);
+      fill(current_buffer, buffer_end, current_param->spec.fill);
+      current_buffer = buffer_end;
+      ++current_param;
+    } else {
+      // Copies only the first brace of {{ or }}
+      const auto token_begin = std::next(s.cbegin(), pos);
+      copy(token_begin, std::next(token_begin, token.length), current_buffer);
+      std::advance(current_buffer, token.length);
+    }
+
+    pos += token.size;
+  }
+}
+
+template <typename S>
+constexpr auto make_buffer(S)
+{
+  using layout_t = format_layout<S>;
+  std::array<char, layout_t::full_length_v> buffer{};
+  fill_buffer(S::to_string_view(), layout_t::params_v, buffer);
+  return buffer;
+}
+
+// Part of the message measured by a length or checksum param: chars from
+// `begin` to `end` of the output buffer, which contain params
+// [first_param, end_param).
+struct param_range
+{
+  // Index of the length or checksum param
+  unsigned param{};
+  unsigned begin{};
+  unsigned end{};
+  unsigned first_param{};
+  unsigned end_param{};
+  bool valid{};
+};
+
+// Index of the param that `ref` refers to by index or name, e.g. `3` or
+// `body`, or `ParamsCount` if there is none.
+template <typename S>
+constexpr unsigned param_ref_index(std::string_view ref)
+{
+  using layout_t = format_layout<S>;
+  const auto digits =
+    find_if(ref.cbegin(), ref.cend(), [](char c) { return !is_digit(c); }) ==
+    ref.cend();
+
+  if (!digits) {
+    return layout_t::index_of(ref);
+  }
+
+  const auto index = stou(ref);
+  return index < layout_t::params_count_v ? index : layout_t::params_count_v;
+}
+
+// Ranges of the `Count` params of kind `Kind` of `S`, in order. Empty `FROM`
+// of `{len:FROM..TO}` is the beginning of the message, empty `TO` is its end.
+template <typename S, param_kind Kind, unsigned Count>
+constexpr auto make_param_ranges()
+{
+  using layout_t = format_layout<S>;
+  constexpr auto params_count = layout_t::params_count_v;
+  std::array<param_range, Count> ranges{};
+  auto current = 0u;
+
+  for (auto n = 0u; n < params_count; ++n) {
+    const auto& param = layout_t::params_v[n];
+    if (param.kind != Kind) {
+      continue;
+    }
+
+    const auto range_string = length_range_string(
+      parse_typed_param(
+        S::to_string_view().substr(param.pos_in_original, param.format_size))
+        .param);
+    auto& range = ranges[current++];
+    range.param = n;
+
+    auto dots = 0u;
+    while (dots + 1u < range_string.size() &&
+           (range_string[dots] != '.' || range_string[dots + 1u] != '.')) {
+      ++dots;
+    }
+    if (dots + 1u >= range_string.size()) {
+      continue;
+    }
+
+    const auto from = range_string.substr(0u, dots);
+    const auto to = range_string.substr(dots + 2u);
+    range.first_param = from.empty() ? 0u : param_ref_index<S>(from);
+    range.end_param = to.empty() ? params_count : param_ref_index<S>(to);
+    range.valid = range.first_param <= range.end_param &&
+                  (from.empty() || range.first_param < params_count) &&
+                  (to.empty() || range.end_param < params_count);
+    if (range.valid) {
+      const auto& params = layout_t::params_v;
+      range.begin =
+        from.empty() ? 0u : params[range.first_param].pos_in_output_buffer;
+      range.end = to.empty() ? layout_t::full_length_v
+                             : params[range.end_param].pos_in_output_buffer;
+    }
+  }
+
+  return ranges;
+}
+
+constexpr unsigned digits_in_base(std::uint64_t value, unsigned base)
+{
+  auto count = 1u;
+  while (value >= base) {
+    value /= base;
+    ++count;
+  }
+  return count;
+}
+
+// Writes `count` digits of `value` before `end` of `buffer` during constant
+// evaluation.
+template <typename Buffer>
+constexpr void write_digits_image(Buffer& buffer, unsigned end,
+                                  std::uint64_t value, unsigned count,
+                                  unsigned base, bool uppercase)
+{
+  const auto digits = uppercase ? upper_digits : lower_digits;
+
+  for (auto i = 0u; i < count; ++i) {
+    buffer[--end] = digits[value % base];
+    value /= base;
+  }
+}
+
+// Writes `value` to the slot of integer `param` in `buffer` during constant
+// evaluation, e.g. the initial value of a length param.
+template <typename Buffer>
+constexpr void write_integer_image(Buffer& buffer,
+                                   const param_descriptor& param,
+                                   std::uint64_t value)
+{
+  const auto& spec = param.spec;
+  const auto count = digits_in_base(value, spec.base);
+  const auto end = param.pos_in_output_buffer +
+                   (spec.align == param_align::right ? param.length : count);
+  write_digits_image(buffer, end, value, count, spec.base, spec.uppercase);
+}
+
+template <std::size_t Count>
+constexpr bool ranges_valid(const std::array<param_range, Count>& ranges)
+{
+  for (const auto& range : ranges) {
+    if (!range.valid) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <std::size_t Count>
+constexpr bool in_any_range(const std::array<param_range, Count>& ranges,
+                            unsigned n)
+{
+  for (const auto& range : ranges) {
+    if (range.first_param <= n && n < range.end_param) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Checks that no checksum depends on itself, directly or through checksums
+// in its range, so that updates of checksums end.
+template <std::size_t FixCount, std::size_t CrcCount>
+constexpr bool checksums_acyclic(
+  const std::array<param_range, FixCount>& fix_ranges,
+  const std::array<param_range, CrcCount>& crc_ranges)
+{
+  constexpr auto count = FixCount + CrcCount;
+  std::array<param_range, count> ranges{};
+  for (auto i = 0u; i < FixCount; ++i) {
+    ranges[i] = fix_ranges[i];
+  }
+  for (auto i = 0u; i < CrcCount; ++i) {
+    ranges[FixCount + i] = crc_ranges[i];
+  }
+
+  // `depends[i * count + j]`: checksum `i` depends on checksum `j`
+  std::array<bool, count * count> depends{};
+  for (auto i = 0u; i < count; ++i) {
+    for (auto j = 0u; j < count; ++j) {
+      depends[i * count + j] = ranges[i].first_param <= ranges[j].param &&
+                               ranges[j].param < ranges[i].end_param;
+    }
+  }
+  for (auto k = 0u; k < count; ++k) {
+    for (auto i = 0u; i < count; ++i) {
+      for (auto j = 0u; j < count; ++j) {
+        depends[i * count + j] = depends[i * count + j] ||
+                                 (depends[i * count + k] &&
+                                  depends[k * count + j]);
+      }
+    }
+  }
+
+  for (auto i = 0u; i < count; ++i) {
+    if (depends[i * count + i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Calls `f(offset, length)` with every part of the output of `S` in `range`,
+// in order: plain text and the first `written(n)` chars of every param.
+template <typename S, typename Written, typename F>
+constexpr void for_each_range_part(const param_range& range,
+                                   const Written& written, F&& f)
+{
+  const auto& params = format_layout<S>::params_v;
+  auto offset = range.begin;
+
+  for (auto n = range.first_param; n < range.end_param; ++n) {
+    const auto slot_offset = params[n].pos_in_output_buffer;
+    f(offset, slot_offset - offset);
+    f(slot_offset, written(n));
+    offset = slot_offset + params[n].length;
+  }
+
+  f(offset, range.end - offset);
+}
+
+// Table of CRC-32C (Castagnoli), reflected polynomial 0x82F63B78
+inline constexpr auto crc32c_table = [] {
+  std::array<std::uint32_t, 256u> table{};
+  for (auto i = 0u; i < table.size(); ++i) {
+    auto crc = i;
+    for (auto bit = 0u; bit < 8u; ++bit) {
+      crc = (crc >> 1u) ^ (0x82F63B78u & (0u - (crc & 1u)));
+    }
+    table[i] = crc;
+  }
+  return table;
+}();
+
+// Continues CRC-32C `crc` (without the final xor) with `size` chars. Usable
+// during constant evaluation.
+constexpr std::uint32_t crc32c_update_table(std::uint32_t crc,
+                                            const char* data,
+                                            std::size_t size)
+{
+  for (auto i = 0u; i < size; ++i) {
+    crc = (crc >> 8u) ^
+          crc32c_table[(crc ^ static_cast<unsigned char>(data[i])) & 0xffu];
+  }
+  return crc;
+}
+
+// Like `crc32c_update_table`, with the SSE4.2 `crc32` instruction when
+// available, 8 chars at a time.
+inline std::uint32_t crc32c_update(std::uint32_t crc, const char* data,
+                                   std::size_t size)
+{
+#if defined(__SSE4_2__) && defined(__x86_64__)
+  auto crc64 = std::uint64_t{ crc };
+  for (; size >= 8u; size -= 8u, data += 8) {
+    std::uint64_t chunk;
+    std::memcpy(&chunk, data, 8u);
+    crc64 = _mm_crc32_u64(crc64, chunk);
+  }
+  crc = static_cast<std::uint32_t>(crc64);
+  if ((size & 4u) != 0u) {
+    std::uint32_t chunk;
+    std::memcpy(&chunk, data, 4u);
+    crc = _mm_crc32_u32(crc, chunk);
+    data += 4;
+  }
+  if ((size & 2u) != 0u) {
+    std::uint16_t chunk;
+    std::memcpy(&chunk, data, 2u);
+    crc = _mm_crc32_u16(crc, chunk);
+    data += 2;
+  }
+  if ((size & 1u) != 0u) {
+    crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*data));
+  }
+  return crc;
+#else
+  return crc32c_update_table(crc, data, size);
+#endif
+}
+
+// Product of polynomials `a` and `b` modulo the CRC-32C polynomial, both
+// reflected like CRC values, i.e. bit 31 is x^0.
+constexpr std::uint32_t crc32c_multiply(std::uint32_t a, std::uint32_t b)
+{
+  auto product = std::uint32_t{};
+  for (auto bit = std::uint32_t{ 1u } << 31u; bit != 0u; bit >>= 1u) {
+    if ((a & bit) != 0u) {
+      product ^= b;
+    }
+    b = (b >> 1u) ^ (0x82F63B78u & (0u - (b & 1u)));
+  }
+  return product;
+}
+
+// x^(8 * bytes) modulo the CRC-32C polynomial
+constexpr std::uint32_t crc32c_zeros_power(std::uint64_t bytes)
+{
+  auto result = std::uint32_t{ 1u } << 31u;
+  // x^8, squared for every bit of `bytes`
+  auto power = std::uint32_t{ 1u } << 23u;
+  for (; bytes != 0u; bytes >>= 1u) {
+    if ((bytes & 1u) != 0u) {
+      result = crc32c_multiply(result, power);
+    }
+    power = crc32c_multiply(power, power);
+  }
+  return result;
+}
+
+// Continues a CRC-32C register with a constant number of zero chars, in 8
+// table lookups. CRC is linear, so the change of a CRC caused by a change of
+// a slot is the CRC of the changed chars, continued with the chars between
+// the slot and the end of the range, which are zeros in the difference.
+class crc32c_zeros
+{
+public:
+  constexpr explicit crc32c_zeros(std::uint64_t bytes)
+  {
+    const auto power = crc32c_zeros_power(bytes);
+    for (auto nibble = 0u; nibble < 8u; ++nibble) {
+      for (auto value = 0u; value < 16u; ++value) {
+        m_tables[nibble][value] =
+          crc32c_multiply(power, value << (nibble * 4u));
+      }
+    }
+  }
+
+  constexpr std::uint32_t operator()(std::uint32_t crc) const
+  {
+    auto result = std::uint32_t{};
+    for (auto nibble = 0u; nibble < 8u; ++nibble) {
+      result ^= m_tables[nibble][(crc >> (nibble * 4u)) & 0xfu];
+    }
+    return result;
+  }
+
+private:
+  std::array<std::array<std::uint32_t, 16u>, 8u> m_tables{};
+};
+
+// Makes the formatter write to memory given by the caller, see
+// `formatter_view`.
+struct external_memory_t
+{
+};
+
+// Buffer of a formatter that writes to memory owned by the caller, with the
+// interface of `std::array` that the formatter uses.
+template <std::size_t Size>
+class external_buffer
+{
+public:
+  constexpr explicit external_buffer(char* data)
+    : m_data{ data }
+  {
+  }
+
+  // A formatter keeps state of the memory besides the memory, e.g. lengths of
+  // written values. Two formatters of the same memory would disagree on it.
+  external_buffer(const external_buffer&) = delete;
+  external_buffer& operator=(const external_buffer&) = delete;
+
+  constexpr external_buffer(external_buffer&& other) noexcept
+    : m_data{ std::exchange(other.m_data, nullptr) }
+  {
+  }
+
+  constexpr external_buffer& operator=(external_buffer&& other) noexcept
+  {
+    m_data = std::exchange(other.m_data, nullptr);
+    return *this;
+  }
+
+  char* data() { return m_data; }
+  const char* data() const { return m_data; }
+  static constexpr std::size_t size() { return Size; }
+
+  char& operator[](std::size_t n) { return m_data[n]; }
+  const char& operator[](std::size_t n) const { return m_data[n]; }
+
+private:
+  char* m_data = nullptr;
+};
+
+// Marks a segment of plain text, i.e. not a param.
+inline constexpr auto plain_segment = std::numeric_limits<unsigned>::max();
+
+// Up to this number of segments, they are copied with an unrolled sequence
+// of constant-size copies. Above it, with a loop, so that huge format strings
+// don't need a function instantiation per segment.
+inline constexpr auto max_unrolled_segments = 64u;
+
+// Chars of the output buffer, e.g. slot of a param.
+struct byte_range
+{
+  unsigned offset;
+  unsigned length;
+};
+
+// Part of the output buffer: plain text between params or a param's slot.
+struct segment_info
+{
+  unsigned offset{};
+  unsigned length{};
+  // Index of the param or `plain_segment`
+  unsigned param{ plain_segment };
+};
+
+// Plain text parts of the output buffer. Part `i` is before param `i`, the
+// last one is after the last param. Some of them can be empty.
+template <unsigned FullLength, typename... Params>
+struct plain_parts
+{
+  static constexpr unsigned begins[] = {
+    0u, (Params::pos_in_output_buffer_v + Params::length_v)...
+  };
+  static constexpr unsigned ends[] = { Params::pos_in_output_buffer_v...,
+                                       FullLength };
+  static constexpr unsigned param_lengths[] = { Params::length_v..., 0u };
+
+  static constexpr unsigned total_size()
+  {
+    auto size = 0u;
+    for (auto i = 0u; i <= sizeof...(Params); ++i) {
+      size += ends[i] - begins[i];
+    }
+    return size;
+  }
+
+  static constexpr unsigned non_empty_count()
+  {
+    auto count = 0u;
+    for (auto i = 0u; i <= sizeof...(Params); ++i) {
+      count += begins[i] != ends[i];
+    }
+    return count;
+  }
+};
+
+// Segments of the output buffer in order: non-empty plain text parts and all
+// the params.
+template <unsigned FullLength, typename... Params>
+constexpr auto make_segments()
+{
+  using parts = plain_parts<FullLength, Params...>;
+  constexpr auto params_count = static_cast<unsigned>(sizeof...(Params));
+
+  std::array<segment_info, parts::non_empty_count() + params_count>
+    segments{};
+  auto current = 0u;
+
+  for (auto i = 0u; i <= params_count; ++i) {
+    if (parts::begins[i] != parts::ends[i]) {
+      segments[current++] = { parts::begins[i],
+                              parts::ends[i] - parts::begins[i],
+                              plain_segment };
+    }
+    if (i < params_count) {
+      segments[current++] = { parts::ends[i], parts::param_lengths[i], i };
+    }
+  }
+
+  return segments;
+}
+
+// Writes only `value` at the beginning of slot of `Param`. Returns pointer
+// past the last written char. `overflow` is passed to `write_floating`.
+template <typename Param, typename T>
+inline char* write_number(char* first, T value, bool* overflow = nullptr)
+{
+  if constexpr (std::is_same_v<T, bool>) {
+    write_bool_pattern<Param::fill_v, false>(first, value);
+    return std::next(first, 4u + !value);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    return write_floating<Param::precision_v>(
+      first, std::next(first, Param::length_v), value, overflow);
+  } else if constexpr (std::is_same_v<T, decimal_param>) {
+    return write_decimal<Param::precision_v>(first, value.mantissa);
+  } else {
+    return write_integer<Param::base_v, Param::uppercase_v>(first, value);
+  }
+}
+
+// Writes `value` into slot of `Param` aligned as the param says, and fills
+// the rest of the slot. Returns pointer past the last written char.
+template <typename Param, typename T>
+inline char* write_number_with_fill(char* first, T value, char fill,
+                                    bool* overflow = nullptr)
+{
+  if constexpr (std::is_same_v<T, bool>) {
+    const auto length = 4u + !value;
+    const auto source = &"truefalse"[4u * !value];
+    std::memset(first, fill, Param::length_v);
+
+    if constexpr (Param::align_v == param_align::right) {
+      std::memcpy(std::next(first, Param::length_v - length), source, length);
+      return std::next(first, Param::length_v);
+    } else {
+      std::memcpy(first, source, length);
+      return std::next(first, length);
+    }
+  } else if constexpr (Param::align_v == param_align::right) {
+    if constexpr (std::is_floating_point_v<T>) {
+      const auto end = write_number<Param>(first, value, overflow);
+      return align_right<Param::length_v>(first, end, fill);
+    } else if constexpr (std::is_same_v<T, decimal_param>) {
+      return write_decimal_right_aligned<Param::length_v, Param::precision_v>(
+        first, value.mantissa, fill);
+    } else {
+      return write_integer_right_aligned<Param::length_v, Param::base_v,
+                                         Param::uppercase_v>(first, value,
+                                                             fill);
+    }
+  } else {
+    // Filling constant number of chars first is a couple of stores, cheaper
+    // than filling the variable-length tail after the value.
+    std::memset(first, fill, Param::length_v);
+    return write_number<Param>(first, value, overflow);
+  }
+}
+
+// Writes `value` into slot of `Param` that begins at `first`, according to
+// the param's alignment. Returns pointer past the last written char.
+template <typename Param, typename T>
+inline char* write_number_slot(char* first, T value, bool* overflow = nullptr)
+{
+  if constexpr (std::is_same_v<T, bool> &&
+                Param::align_v != param_align::none) {
+    constexpr auto pad_front = Param::align_v == param_align::right;
+    if constexpr (Param::length_v > 5u) {
+      std::memset(first, Param::fill_v, Param::length_v);
+    }
+
+    const auto pattern_begin =
+      pad_front ? std::next(first, Param::length_v - 5u) : first;
+    write_bool_pattern<Param::fill_v, pad_front>(pattern_begin, value);
+
+    return pad_front ? std::next(first, Param::length_v)
+                     : std::next(first, 4u + !value);
+  } else if constexpr (Param::align_v == param_align::none) {
+    return write_number<Param>(first, value, overflow);
+  } else {
+    return write_number_with_fill<Param>(first, value, Param::fill_v,
+                                         overflow);
+  }
+}
+
+// Second char of the two-char JSON escape of `c`, e.g. `n` for a new line, or
+// 0 if `c` is escaped as `\u00XX` or not at all.
+constexpr char json_short_escape(char c)
+{
+  switch (c) {
+    case '"':
+      return '"';
+    case '\\':
+      return '\\';
+    case '\b':
+      return 'b';
+    case '\f':
+      return 'f';
+    case '\n':
+      return 'n';
+    case '\r':
+      return 'r';
+    case '\t':
+      return 't';
+    default:
+      return 0;
+  }
+}
+
+constexpr bool json_needs_escape(char c)
+{
+  return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20u;
+}
+
+// Number of chars from `first` that don't need JSON escaping. Scans 32 or 16
+// chars at a time when AVX2 or SSE2 is available.
+inline std::size_t json_plain_prefix(const char* first, const char* last)
+{
+  const auto begin = first;
+
+#if defined(__AVX2__)
+  const auto quote32 = _mm256_set1_epi8('"');
+  const auto backslash32 = _mm256_set1_epi8('\\');
+  const auto control32 = _mm256_set1_epi8(0x1f);
+  while (last - first >= 32) {
+    const auto chars =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    // c <= 0x1f, unsigned, iff min(c, 0x1f) == c
+    const auto special = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(chars, quote32),
+                      _mm256_cmpeq_epi8(chars, backslash32)),
+      _mm256_cmpeq_epi8(_mm256_min_epu8(chars, control32), chars));
+    const auto mask = static_cast<unsigned>(_mm256_movemask_epi8(special));
+    if (mask != 0u) {
+      return static_cast<std::size_t>(first - begin) + __builtin_ctz(mask);
+    }
+    first += 32;
+  }
+#endif
+
+#if defined(__SSE2__)
+  const auto quote = _mm_set1_epi8('"');
+  const auto backslash = _mm_set1_epi8('\\');
+  const auto control = _mm_set1_epi8(0x1f);
+  while (last - first >= 16) {
+    const auto chars =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    const auto special = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(chars, quote),
+                   _mm_cmpeq_epi8(chars, backslash)),
+      _mm_cmpeq_epi8(_mm_min_epu8(chars, control), chars));
+    const auto mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+    if (mask != 0u) {
+      return static_cast<std::size_t>(first - begin) + __builtin_ctz(mask);
+    }
+    first += 16;
+  }
+#endif
+
+  while (first != last && !json_needs_escape(*first)) {
+    ++first;
+  }
+  return static_cast<std::size_t>(first - begin);
+}
+
+// Writes JSON-escaped `value` to [first, last). Stops before a char that
+// doesn't fit, so an escape sequence or UTF-8 code point is never cut, and
+// sets `*truncated`, if given. Returns pointer past the last written char.
+inline char* write_json_escaped(char* first, char* last,
+                                std::string_view value,
+                                bool* truncated = nullptr)
+{
+  while (!value.empty()) {
+    const auto room = static_cast<std::size_t>(last - first);
+    auto plain = json_plain_prefix(value.data(), value.data() + value.size());
+
+    if (plain >= room && plain > 0u) {
+      // Truncated. Don't leave a part of a multi-byte code point behind.
+      plain = room;
+      while (plain > 0u && plain < value.size() &&
+             (static_cast<unsigned char>(value[plain]) & 0xc0u) == 0x80u) {
+        --plain;
+      }
+      std::memcpy(first, value.data(), plain);
+      if (truncated != nullptr) {
+        *truncated = plain < value.size();
+      }
+      return std::next(first, plain);
+    }
+
+    std::memcpy(first, value.data(), plain);
+    first = std::next(first, plain);
+    value.remove_prefix(plain);
+
+    if (value.empty()) {
+      break;
+    }
+
+    const auto c = value.front();
+    const auto short_escape = json_short_escape(c);
+    const auto escape_length = short_escape ? 2 : 6;
+    if (last - first < escape_length) {
+      if (truncated != nullptr) {
+        *truncated = true;
+      }
+      break;
+    }
+
+    first[0] = '\\';
+    if (short_escape) {
+      first[1] = short_escape;
+    } else {
+      constexpr auto hex = "0123456789abcdef";
+      const auto code = static_cast<unsigned char>(c);
+      std::memcpy(&first[1], "u00", 3u);
+      first[4] = hex[code >> 4u];
+      first[5] = hex[code & 0xfu];
+    }
+    first = std::next(first, escape_length);
+    value.remove_prefix(1u);
+  }
+
+  return first;
+}
+
+// `write_string_slot` for JSON strings. The value is escaped while copied.
+template <typename Param>
+inline char* write_json_string_slot(char* first, std::string_view value,
+                                    bool* truncated = nullptr)
+{
+  const auto last = std::next(first, Param::length_v);
+  const auto end = write_json_escaped(first, last, value, truncated);
+
+  if constexpr (Param::align_v == param_align::right) {
+    const auto length = static_cast<std::size_t>(end - first);
+    std::memmove(std::prev(last, length), first, length);
+    std::fill(first, std::prev(last, length), Param::fill_v);
+    return last;
+  } else {
+    if constexpr (Param::align_v == param_align::left) {
+      std::fill(end, last, Param::fill_v);
+    }
+    return end;
+  }
+}
+
+inline constexpr std::int64_t ns_per_second = 1'000'000'000;
+inline constexpr std::int64_t ns_per_minute = 60 * ns_per_second;
+inline constexpr std::int64_t ns_per_day = 24 * 60 * ns_per_minute;
+
+// Chars of `YYYY-MM-DDTHH:MM:` that don't change within a minute
+inline constexpr auto timestamp_minute_prefix_length = 17u;
+
+// Start of the minute of a written timestamp, nothing before the first one
+using minute_start_t = std::optional<std::int64_t>;
+
+constexpr bool in_minute(const minute_start_t& minute_start, std::int64_t ns)
+{
+  return minute_start &&
+         static_cast<std::uint64_t>(ns) -
+             static_cast<std::uint64_t>(*minute_start) <
+           static_cast<std::uint64_t>(ns_per_minute);
+}
+
+struct civil_date
+{
+  int year;
+  unsigned month;
+  unsigned day;
+};
+
+// Date of the given day since the Unix epoch, in the proleptic Gregorian
+// calendar. From Howard Hinnant's `civil_from_days`.
+constexpr civil_date civil_from_days(std::int64_t days)
+{
+  days += 719468;
+  const auto era = (days >= 0 ? days : days - 146096) / 146097;
+  const auto day_of_era = static_cast<unsigned>(days - era * 146097);
+  const auto year_of_era = (day_of_era - day_of_era / 1460 +
+                            day_of_era / 36524 - day_of_era / 146096) /
+                           365;
+  const auto day_of_year =
+    day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  const auto mp = (5 * day_of_year + 2) / 153;
+  const auto day = day_of_year - (153 * mp + 2) / 5 + 1;
+  const auto month = mp < 10 ? mp + 3 : mp - 9;
+  const auto year = static_cast<int>(year_of_era + era * 400) + (month <= 2);
+  return { year, month, day };
+}
+
+inline void write_2_digits(char* first, unsigned value)
+{
+  std::memcpy(first, &digit_pairs[value * 2u], 2u);
+}
+
+// Writes `SS.nnnnnnnnnZ` of nanoseconds within a minute at `first`.
+inline void write_timestamp_seconds(char* first, std::int64_t ns_of_minute)
+{
+  const auto seconds = static_cast<unsigned>(ns_of_minute / ns_per_second);
+  const auto fraction =
+    static_cast<std::uint32_t>(ns_of_minute % ns_per_second);
+
+  write_2_digits(first, seconds);
+  first[2] = '.';
+  write_8_digits_backward(std::next(first, 12), fraction % 100000000u);
+  first[3] = static_cast<char>('0' + fraction / 100000000u);
+  first[12] = 'Z';
+}
+
+// Writes `YYYY-MM-DDTHH:MM:SS.nnnnnnnnnZ` of `ns` since the Unix epoch at
+// `first`. Years must have four digits. Returns start of the minute of `ns`.
+inline std::int64_t write_timestamp(char* first, std::int64_t ns)
+{
+  auto days = ns / ns_per_day;
+  auto ns_of_day = ns % ns_per_day;
+  if (ns_of_day < 0) {
+    --days;
+    ns_of_day += ns_per_day;
+  }
+
+  const auto date = civil_from_days(days);
+  const auto minutes = static_cast<unsigned>(ns_of_day / ns_per_minute);
+  const auto ns_of_minute = ns_of_day % ns_per_minute;
+
+  const auto year = static_cast<unsigned>(date.year);
+  write_2_digits(first, year / 100u);
+  write_2_digits(std::next(first, 2), year % 100u);
+  first[4] = '-';
+  write_2_digits(std::next(first, 5), date.month);
+  first[7] = '-';
+  write_2_digits(std::next(first, 8), date.day);
+  first[10] = 'T';
+  write_2_digits(std::next(first, 11), minutes / 60u);
+  first[13] = ':';
+  write_2_digits(std::next(first, 14), minutes % 60u);
+  first[16] = ':';
+  write_timestamp_seconds(std::next(first, timestamp_minute_prefix_length),
+                          ns_of_minute);
+
+  return ns - ns_of_minute;
+}
+
+// String counterpart of `write_number_slot`. Values longer than the slot are
+// truncated.
+template <typename Param>
+inline char* write_string_slot(char* first, std::string_view value)
+{
+  value = value.substr(0u, Param::length_v);
+
+  if constexpr (Param::align_v == param_align::right) {
+    const auto end = std::next(first, Param::length_v);
+    const auto value_begin = std::prev(end, value.size());
+    std::fill(first, value_begin, Param::fill_v);
+    std::copy(value.cbegin(), value.cend(), value_begin);
+    return end;
+  } else {
+    const auto end = std::copy(value.cbegin(), value.cend(), first);
+    if constexpr (Param::align_v == param_align::left) {
+      std::fill(end, std::next(first, Param::length_v), Param::fill_v);
+    }
+    return end;
+  }
+}
+
+template <typename S, typename Options, typename... Params>
+class formatter
+{
+  static constexpr auto external_memory_v =
+    has_option<external_memory_t>(Options{});
+
+public:
+  // Formatters with external memory need the memory
+  template <bool External = external_memory_v,
+            std::enable_if_t<!External, int> = 0>
+  constexpr formatter()
+  {
+  }
+
+  // Writes the message template to `memory`, which must have room for
+  // `size()` chars, and formats there from now on. Only for formatters with
+  // external memory.
+  template <bool External = external_memory_v,
+            std::enable_if_t<External, int> = 0>
+  explicit formatter(char* memory)
+    : m_buffer{ memory }
+  {
+    std::memcpy(memory, image_v.data(), image_v.size());
+  }
+
+  static constexpr std::size_t size() { return buffer_size_v; }
+
+  static constexpr auto npos = std::numeric_limits<unsigned>::max();
+
+  // Index of the param named `name`, e.g. `seq_no` in `{seq_no:uint64_t}`,
+  // or `npos` if there is none.
+  static constexpr unsigned index_of(std::string_view name)
+  {
+    const auto index = format_layout<S>::index_of(name);
+    return index < sizeof...(Params) ? index : npos;
+  }
+
+  // `set` of the param named `Name`, given as `INFMT_STRING("seq_no")`. The
+  // index is found at compile time.
+  template <typename Name, typename Value>
+  auto set(Name, const Value& val)
+  {
+    constexpr auto index = index_of(Name::to_string_view());
+    static_assert(index != npos, "No param with this name");
+
+    using param_t = layout_param_t<S, index>;
+    if constexpr (is_string_param_v<typename param_t::type_t>) {
+      return set<index>(std::string_view{ val });
+    } else {
+      return set<index, Value>(val);
+    }
+  }
+
+  // Writes `val` to param `N`. Numbers are converted to the type of the param
+  // first, like in an assignment, e.g. 300 to `{uint8_t}` is 44. Returns
+  // pointer past the written value.
+  template <unsigned N, typename Value>
+  auto set(const Value& val)
+  {
+    const auto end = write<N, Value>(val);
+    update_checksums();
+    return end;
+  }
+
+  template <unsigned N>
+  auto set(std::string_view value)
+  {
+    const auto end = write<N>(value);
+    update_checksums();
+    return end;
+  }
+
+  // Sets every param, in order. Offsets of all the params are known at
+  // compile time, so this compiles to one straight sequence of writes.
+  template <typename... Values>
+  void set_all(const Values&... values)
+  {
+    static_assert(sizeof...(Values) == settable_count_v,
+                  "set_all needs exactly one value per param, except length "
+                  "params and marks");
+    set_all_impl(std::make_index_sequence<settable_count_v>{}, values...);
+    update_checksums();
+  }
+
+  // Sets params with the given indexes, e.g. `set_some<0, 3>(seq_no, qty)`.
+  template <unsigned... Ns, typename... Values>
+  void set_some(const Values&... values)
+  {
+    static_assert(sizeof...(Ns) == sizeof...(Values),
+                  "set_some needs exactly one value per index");
+    (set_value<Ns>(values), ...);
+    update_checksums();
+  }
+
+  template <unsigned N, typename Value>
+  void set_with_fill(const Value& val, char fill)
+  {
+    using param_t = layout_param_t<S, N>;
+    using value_t = typename param_t::type_t;
+    const auto param_buf = param_t::to_span(m_buffer);
+
+    auto overflow = false;
+    const auto end = write_number_with_fill<param_t>(
+      param_buf.begin(), static_cast<value_t>(val), fill,
+      collect_stats_v ? &overflow : nullptr);
+
+    if constexpr (track_written_v && param_t::align_v == param_align::none) {
+      set_written<N>(static_cast<unsigned>(end - param_buf.begin()));
+    }
+    // Unaligned params are filled up to the end of the slot too
+    count_write<N>(param_buf.begin(), end,
+                   param_t::align_v == param_align::none
+                     ? static_cast<unsigned>(param_buf.end() - end)
+                     : 0u,
+                   overflow, fill);
+    after_set<N>();
+    update_checksums();
+  }
+
+  template <unsigned N, typename Value>
+  void set_with_fill_hint(const Value& val, char fill, char* max_fill_hint)
+  {
+    using param_t = layout_param_t<S, N>;
+    using value_t = typename param_t::type_t;
+    const auto param_buf = param_t::to_span(m_buffer);
+    auto overflow = false;
+    const auto ptr =
+      write_number_slot<param_t>(param_buf.begin(), static_cast<value_t>(val),
+                                 collect_stats_v ? &overflow : nullptr);
+
+    if constexpr (track_written_v &&
+                  param_t::align_v == param_align::none) {
+      // Stale chars are known anyway. Clear them too, with the given fill.
+      const auto stale_end = std::next(param_buf.begin(), m_written[N]);
+      max_fill_hint = std::max(max_fill_hint, stale_end);
+      set_written<N>(static_cast<unsigned>(ptr - param_buf.begin()));
+    }
+
+    if (ptr < max_fill_hint) {
       std::fill(ptr, max_fill_hint, fill);
     }
+    count_write<N>(param_buf.begin(), ptr,
+                   ptr < max_fill_hint
+                     ? static_cast<unsigned>(max_fill_hint - ptr)
+                     : 0u,
+                   overflow);
+    after_set<N>();
+    update_checksums();
+  }
+
+  // Params set since the previous call, and forgets them. Needs
+  // `track_dirty`.
+  std::bitset<sizeof...(Params)> take_dirty()
+  {
+    static_assert(track_dirty_v, "take_dirty needs the track_dirty option");
+    const auto dirty = m_dirty;
+    m_dirty.reset();
+    return dirty;
+  }
+
+  // Calls `f(offset, bytes)` with the slot of every param set since the
+  // previous call, and forgets them. Needs `track_dirty`.
+  template <typename F>
+  void take_dirty_ranges(F&& f)
+  {
+    const auto dirty = take_dirty();
+    for (auto n = 0u; n < sizeof...(Params); ++n) {
+      if (dirty[n]) {
+        const auto range = slot_ranges_v[n];
+        f(range.offset, std::string_view{ &m_buffer[range.offset],
+                                          range.length });
+      }
+    }
+  }
+
+  // Counters of every param since construction or the last `reset_stats`.
+  // Needs `collect_stats`. Batches written with `format_rows` aren't
+  // counted.
+  const std::array<param_stats, sizeof...(Params)>& stats() const
+  {
+    static_assert(collect_stats_v, "stats needs the collect_stats option");
+    return m_stats;
+  }
+
+  void reset_stats()
+  {
+    static_assert(collect_stats_v,
+                  "reset_stats needs the collect_stats option");
+    m_stats = {};
+  }
+
+  // Offset and length of the slot of param `n` in the buffer.
+  static constexpr byte_range slot_range(unsigned n)
+  {
+    return slot_ranges_v[n];
+  }
+
+  // Adds `delta` to the unsigned decimal param `N` in place, carrying through
+  // the digits already in the slot, so usually only the last digit changes.
+  // Falls back to rewriting the value when it needs more digits than fit in
+  // place, or wraps around the maximum of the param's type.
+  template <unsigned N>
+  void add(std::uint64_t delta)
+  {
+    add_with_carry<N>(delta, 0u);
+    update_checksums();
+  }
+
+  template <unsigned N>
+  void increment()
+  {
+    add_with_carry<N>(0u, 1u);
+    update_checksums();
+  }
+
+  // Formats rows [first, last) of `columns` into `arena`, e.g. to export
+  // many records. Row `i` is the message at `arena + i * size()`, the same as
+  // `to_string_view()` of a new formatter after `set_all` with the values of
+  // the row. A column is anything indexed by row, like a pointer or
+  // a vector, one per param that `set_all` takes. Every row is stamped with
+  // the image and its values are written with constant offsets, without
+  // the formatter's state. Threads can format disjoint rows of the same
+  // arena.
+  template <typename... Columns>
+  static void format_rows(char* arena, std::size_t first, std::size_t last,
+                          const Columns&... columns)
+  {
+    static_assert(sizeof...(Columns) == settable_count_v,
+                  "format_rows needs exactly one column per param, except "
+                  "length params, marks and checksums");
+    static_assert(!track_written_v,
+                  "format_rows writes whole slots, so it needs a formatter "
+                  "without track_written");
+
+    auto minutes = batch_minutes{};
+    auto message = std::next(arena, first * buffer_size_v);
+
+    for (auto row = first; row < last; ++row) {
+      std::memcpy(message, image_v.data(), buffer_size_v);
+      format_row(message, row, minutes,
+                 std::make_index_sequence<settable_count_v>{}, columns...);
+
+      if constexpr (checksum_order_v.size() != 0u) {
+        write_row_checksums(
+          message, std::make_index_sequence<checksum_order_v.size()>{});
+      }
+      std::advance(message, buffer_size_v);
+    }
+  }
+
+  // Length of the current value of param `N`. It's the whole slot, unless
+  // the formatter tracks written values and the param is not aligned.
+  template <unsigned N>
+  unsigned written_length() const
+  {
+    if constexpr (track_written_v) {
+      return m_written[N];
+    } else {
+      return layout_param_t<S, N>::length_v;
+    }
+  }
+
+  // Plain text parts and written parts of the params, in order. Together they
+  // make the message without the params' padding (with `track_written`).
+  // The views are valid for the formatter lifetime.
+  auto segments() const
+  {
+    if constexpr (segments_v.size() <= max_unrolled_segments) {
+      return segments_impl(std::make_index_sequence<segments_v.size()>{});
+    } else {
+      std::array<std::string_view, segments_v.size()> result{};
+      for (auto i = 0u; i < segments_v.size(); ++i) {
+        result[i] = segment(segments_v[i]);
+      }
+      return result;
+    }
+  }
+
+  // Copies `segments` back to back to `out`, which must have room for the
+  // whole buffer. Returns pointer past the last copied char.
+  char* copy_to(char* out) const
+  {
+    if constexpr (segments_v.size() <= max_unrolled_segments) {
+      return copy_to_impl(out,
+                          std::make_index_sequence<segments_v.size()>{});
+    } else {
+      for (const auto& info : segments_v) {
+        const auto view = segment(info);
+        std::memcpy(out, view.data(), view.size());
+        std::advance(out, view.size());
+      }
+      return out;
+    }
+  }
+
+  // Number of chars that `copy_to` copies.
+  unsigned compact_size() const
+  {
+    constexpr auto plain_size =
+      plain_parts<buffer_size_v, Params...>::total_size();
+    auto size = plain_size;
+
+    for (auto n = 0u; n < sizeof...(Params); ++n) {
+      size += written_length(n);
+    }
+
+    return size;
+  }
+
+#ifdef INFMT_HAS_IOVEC
+  // `segments` ready to be passed to `writev` or `sendmsg`.
+  auto to_iovec() const
+  {
+    const auto views = segments();
+    std::array<iovec, segments_v.size()> result{};
+
+    for (auto i = 0u; i < views.size(); ++i) {
+      result[i].iov_base = const_cast<char*>(views[i].data());
+      result[i].iov_len = views[i].size();
+    }
+
+    return result;
+  }
+#endif
+
+  decltype(auto) operator[](unsigned n) { return m_buffer[n]; }
+
+  constexpr auto to_string_view() const
+  {
+    return std::string_view{ m_buffer.data(), m_buffer.size() };
+  }
+
+private:
+  static constexpr auto track_written_v =
+    has_option<track_written_t>(Options{});
+  static constexpr auto track_dirty_v = has_option<track_dirty_t>(Options{});
+  static constexpr auto collect_stats_v =
+    has_option<collect_stats_t>(Options{});
+
+  static constexpr auto length_params_count_v =
+    (0u + ... + std::is_same_v<typename Params::type_t, length_param>);
+  static constexpr auto fixsums_count_v =
+    (0u + ... + std::is_same_v<typename Params::type_t, fix_checksum_param>);
+  static constexpr auto crcs_count_v =
+    (0u + ... + std::is_same_v<typename Params::type_t, crc32c_param>);
+  static constexpr auto length_ranges_v =
+    make_param_ranges<S, param_kind::len, length_params_count_v>();
+  static constexpr auto fixsum_ranges_v =
+    make_param_ranges<S, param_kind::fixsum, fixsums_count_v>();
+  static constexpr auto crc_ranges_v =
+    make_param_ranges<S, param_kind::crc32c, crcs_count_v>();
+  // Only unaligned params with `track_written` change their length.
+  // Checksums always fill their slots.
+  static constexpr bool variable_length_v[] = {
+    false, (track_written_v && Params::align_v == param_align::none &&
+            !is_checksum_param_v<typename Params::type_t>)...
+  };
+  static_assert(ranges_valid(length_ranges_v) &&
+                  ranges_valid(fixsum_ranges_v) && ranges_valid(crc_ranges_v),
+                "Range of a length or checksum param must be FROM..TO, where "
+                "FROM and TO are indexes or names of params, in order");
+  // So that setting a param updates lengths in one step
+  static_assert(
+    [] {
+      for (const auto& range : length_ranges_v) {
+        if (variable_length_v[range.param + 1u] &&
+            in_any_range(length_ranges_v, range.param)) {
+          return false;
+        }
+      }
+      return true;
+    }(),
+    "A length param in a range of a length param must be aligned");
+  // Without `track_written` every param fills its slot, so chars never move
+  // and CRCs are patched with the change of every written slot. Otherwise
+  // they are computed again.
+  static constexpr auto patch_crcs_v = !track_written_v && crcs_count_v != 0u;
+  // The minute cache rewrites seconds at a constant offset of the slot
+  static_assert((... && (!std::is_same_v<typename Params::type_t,
+                                         timestamp_param> ||
+                         (Params::align_v == param_align::none &&
+                          Params::length_v == 30u))),
+                "Timestamps are 30 chars and take no align or width");
+  static_assert(fixsums_count_v <= 64u && crcs_count_v <= 64u,
+                "At most 64 checksum params of each kind");
+  static_assert(checksums_acyclic(fixsum_ranges_v, crc_ranges_v),
+                "A checksum param can't be in its own range, also through "
+                "other checksums");
+
+  // Length of every range, before any set
+  static constexpr auto initial_lengths_v = [] {
+    std::array<unsigned, length_params_count_v> lengths{};
+    constexpr unsigned param_lengths[] = { 0u, Params::length_v... };
+    for (auto k = 0u; k < length_params_count_v; ++k) {
+      const auto& range = length_ranges_v[k];
+      lengths[k] = range.end - range.begin;
+      for (auto n = range.first_param; n < range.end_param; ++n) {
+        // Unaligned params start empty
+        if (variable_length_v[n + 1u]) {
+          lengths[k] -= param_lengths[n + 1u];
+        }
+      }
+    }
+    return lengths;
+  }();
+  // Length of the output of every param in the image. Without
+  // `track_written` it's the whole slot. Aligned params and checksums always
+  // take their whole slot, unaligned length params their initial value.
+  static constexpr auto initial_written_v = [] {
+    std::array<unsigned, sizeof...(Params)> written = {
+      (!track_written_v || Params::align_v != param_align::none ||
+           is_checksum_param_v<typename Params::type_t>
+         ? Params::length_v
+         : 0u)...
+    };
+    if (!track_written_v) {
+      return written;
+    }
+    for (auto k = 0u; k < length_params_count_v; ++k) {
+      const auto& param = format_layout<S>::params_v[length_ranges_v[k].param];
+      if (param.spec.align == param_align::none) {
+        written[length_ranges_v[k].param] =
+          digits_in_base(initial_lengths_v[k], param.spec.base);
+      }
+    }
+    return written;
+  }();
+
+  static constexpr auto image_v = [] {
+    const auto& params = format_layout<S>::params_v;
+    const auto written = [](unsigned n) { return initial_written_v[n]; };
+    auto image = make_buffer(S{});
+
+    for (auto k = 0u; k < length_params_count_v; ++k) {
+      write_integer_image(image, params[length_ranges_v[k].param],
+                          initial_lengths_v[k]);
+    }
+
+    // A checksum can be in the range of another one. Every pass makes at
+    // least one more of them final.
+    for (auto pass = 0u; pass < fixsums_count_v + crcs_count_v; ++pass) {
+      for (const auto& range : fixsum_ranges_v) {
+        auto sum = 0u;
+        for_each_range_part<S>(
+          range, written, [&](unsigned offset, unsigned length) {
+            for (auto i = offset; i < offset + length; ++i) {
+              sum += static_cast<unsigned char>(image[i]);
+            }
+          });
+        const auto& param = params[range.param];
+        write_digits_image(image, param.pos_in_output_buffer + param.length,
+                           sum % 256u, 3u, 10u, false);
+      }
+
+      for (const auto& range : crc_ranges_v) {
+        auto crc = ~std::uint32_t{};
+        for_each_range_part<S>(
+          range, written, [&](unsigned offset, unsigned length) {
+            crc = crc32c_update_table(crc, image.data() + offset, length);
+          });
+        const auto& param = params[range.param];
+        write_digits_image(image, param.pos_in_output_buffer + param.length,
+                           ~crc, 8u, 16u, param.spec.uppercase);
+      }
+    }
+
+    return image;
+  }();
+  // Sum of the bytes of every param. Used with `{fixsum}` params.
+  static constexpr auto initial_param_sums_v = [] {
+    std::array<unsigned, fixsums_count_v != 0u ? sizeof...(Params) : 0u>
+      sums{};
+    for (auto n = 0u; n < sums.size(); ++n) {
+      const auto offset = format_layout<S>::params_v[n].pos_in_output_buffer;
+      for (auto i = offset; i < offset + initial_written_v[n]; ++i) {
+        sums[n] += static_cast<unsigned char>(image_v[i]);
+      }
+    }
+    return sums;
+  }();
+  // CRC of the bytes of every param, without the initial and final xor. Used
+  // to patch `{crc32c}` params.
+  static constexpr auto initial_param_crcs_v = [] {
+    std::array<std::uint32_t, patch_crcs_v ? sizeof...(Params) : 0u> crcs{};
+    for (auto n = 0u; n < crcs.size(); ++n) {
+      const auto offset = format_layout<S>::params_v[n].pos_in_output_buffer;
+      crcs[n] = crc32c_update_table(0u, image_v.data() + offset,
+                                    initial_written_v[n]);
+    }
+    return crcs;
+  }();
+  // CRC of the range of every `{crc32c}` param, when they are patched
+  static constexpr auto initial_crcs_v = [] {
+    std::array<std::uint32_t, patch_crcs_v ? crcs_count_v : 0u> crcs{};
+    for (auto k = 0u; k < crcs.size(); ++k) {
+      const auto& range = crc_ranges_v[k];
+      crcs[k] = ~crc32c_update_table(~std::uint32_t{},
+                                     image_v.data() + range.begin,
+                                     range.end - range.begin);
+    }
+    return crcs;
+  }();
+  // Continues a CRC of param `N` to the end of the range of `{crc32c}` param
+  // `K`
+  template <unsigned K, unsigned N>
+  static constexpr crc32c_zeros crc_zeros_v{
+    crc_ranges_v[K].end - format_layout<S>::params_v[N].pos_in_output_buffer -
+    format_layout<S>::params_v[N].length
+  };
+  // Sum of the bytes of the range of every `{fixsum}` param, not reduced
+  static constexpr auto initial_fixsums_v = [] {
+    std::array<unsigned, fixsums_count_v> sums{};
+    const auto written = [](unsigned n) { return initial_written_v[n]; };
+    for (auto k = 0u; k < fixsums_count_v; ++k) {
+      for_each_range_part<S>(
+        fixsum_ranges_v[k], written, [&](unsigned offset, unsigned length) {
+          for (auto i = offset; i < offset + length; ++i) {
+            sums[k] += static_cast<unsigned char>(image_v[i]);
+          }
+        });
+    }
+    return sums;
+  }();
+
+  static constexpr auto buffer_size_v =
+    static_cast<unsigned>(std::tuple_size_v<decltype(image_v)>);
+  using buffer_t = std::conditional_t<external_memory_v,
+                                      external_buffer<buffer_size_v>,
+                                      std::remove_const_t<decltype(image_v)>>;
+  static constexpr auto segments_v =
+    make_segments<buffer_size_v, Params...>();
+  static constexpr std::array<unsigned, sizeof...(Params)> param_lengths_v = {
+    Params::length_v...
+  };
+  static constexpr std::array<byte_range, sizeof...(Params)> slot_ranges_v = {
+    byte_range{ Params::pos_in_output_buffer_v, Params::length_v }...
+  };
+  static constexpr auto timestamps_count_v =
+    (0u + ... + std::is_same_v<typename Params::type_t, timestamp_param>);
+  // Index of every param among timestamp params
+  static constexpr std::array<unsigned, sizeof...(Params)>
+    timestamp_indexes_v = [] {
+      constexpr bool is_timestamp[] = {
+        false, std::is_same_v<typename Params::type_t, timestamp_param>...
+      };
+      std::array<unsigned, sizeof...(Params)> result{};
+      auto count = 0u;
+      for (auto n = 0u; n < sizeof...(Params); ++n) {
+        result[n] = count;
+        count += is_timestamp[n + 1u];
+      }
+      return result;
+    }();
+  static constexpr auto settable_count_v =
+    (0u + ... + !is_derived_param_v<typename Params::type_t>);
+  // Indexes of params that can be set, i.e. all but length params and marks
+  static constexpr auto settable_indexes_v = [] {
+    constexpr bool derived[] = {
+      false, is_derived_param_v<typename Params::type_t>...
+    };
+    std::array<unsigned, settable_count_v> indexes{};
+    auto current = 0u;
+    for (auto n = 0u; n < sizeof...(Params); ++n) {
+      if (!derived[n + 1u]) {
+        indexes[current++] = n;
+      }
+    }
+    return indexes;
+  }();
+
+  // Checksum params in an order in which every one comes after the
+  // checksums in its range. Indexes below `fixsums_count_v` are `{fixsum}`
+  // params, the rest are `{crc32c}` ones.
+  static constexpr auto checksum_order_v = [] {
+    constexpr auto count = fixsums_count_v + crcs_count_v;
+    const auto range_of = [](unsigned i) {
+      return i < fixsums_count_v ? fixsum_ranges_v[i]
+                                 : crc_ranges_v[i - fixsums_count_v];
+    };
+    std::array<unsigned, count> order{};
+    std::array<bool, count> placed{};
+    auto current = 0u;
+
+    // Every pass places at least one of them
+    for (auto pass = 0u; pass < count; ++pass) {
+      for (auto i = 0u; i < count; ++i) {
+        auto ready = !placed[i];
+        for (auto j = 0u; j < count && ready; ++j) {
+          const auto& range = range_of(i);
+          ready = placed[j] || range_of(j).param < range.first_param ||
+                  range_of(j).param >= range.end_param;
+        }
+        if (ready) {
+          order[current++] = i;
+          placed[i] = true;
+        }
+      }
+    }
+    return order;
+  }();
+
+  // Minutes of the last timestamps written by `format_rows`, with their
+  // `YYYY-MM-DDTHH:MM:` prefixes. Rows are usually in time order, so most
+  // rows copy the prefix of the previous one.
+  struct batch_minutes
+  {
+    std::array<minute_start_t, timestamps_count_v> starts;
+    std::array<std::array<char, timestamp_minute_prefix_length>,
+               timestamps_count_v>
+      prefixes;
+  };
+
+  template <std::size_t... Is, typename... Columns>
+  static void format_row(char* message, std::size_t row,
+                         batch_minutes& minutes, std::index_sequence<Is...>,
+                         const Columns&... columns)
+  {
+    (format_cell<settable_indexes_v[Is]>(message, row, minutes, columns),
+     ...);
+  }
+
+  // Writes value of `row` of `column` to param `N` of a stamped `message`
+  template <unsigned N, typename Column>
+  static void format_cell(char* message, std::size_t row,
+                          batch_minutes& minutes, const Column& column)
+  {
+    using param_t = layout_param_t<S, N>;
+    using value_t = typename param_t::type_t;
+    const auto first = std::next(message, param_t::pos_in_output_buffer_v);
+
+    if constexpr (std::is_same_v<value_t, timestamp_param>) {
+      constexpr auto index = timestamp_indexes_v[N];
+      auto& minute_start = minutes.starts[index];
+      auto& prefix = minutes.prefixes[index];
+      const auto ns = static_cast<value_t>(column[row]).ns;
+
+      if (in_minute(minute_start, ns)) {
+        std::memcpy(first, prefix.data(), prefix.size());
+        write_timestamp_seconds(
+          std::next(first, timestamp_minute_prefix_length),
+          ns - *minute_start);
+      } else {
+        minute_start = write_timestamp(first, ns);
+        std::memcpy(prefix.data(), first, prefix.size());
+      }
+    } else if constexpr (std::is_same_v<value_t, json_string_param>) {
+      write_json_string_slot<param_t>(first, std::string_view{ column[row] });
+    } else if constexpr (std::is_same_v<value_t, string_param>) {
+      write_string_slot<param_t>(first, std::string_view{ column[row] });
+    } else {
+      write_number_slot<param_t>(first, static_cast<value_t>(column[row]));
+    }
+  }
+
+  // Writes checksums of a row of `format_rows`. Its slots are whole, so
+  // ranges are contiguous.
+  template <std::size_t... Is>
+  static void write_row_checksums(char* message, std::index_sequence<Is...>)
+  {
+    (write_row_checksum<checksum_order_v[Is]>(message), ...);
+  }
+
+  template <unsigned I>
+  static void write_row_checksum(char* message)
+  {
+    if constexpr (I < fixsums_count_v) {
+      constexpr auto range = fixsum_ranges_v[I];
+      auto sum = 0u;
+      for (auto i = range.begin; i < range.end; ++i) {
+        sum += static_cast<unsigned char>(message[i]);
+      }
+      write_fixsum_digits<I>(message, sum);
+    } else {
+      constexpr auto range = crc_ranges_v[I - fixsums_count_v];
+      write_crc_digits<I - fixsums_count_v>(
+        message, ~crc32c_update(~std::uint32_t{},
+                                std::next(message, range.begin),
+                                range.end - range.begin));
+    }
+  }
+
+  template <std::size_t... Is>
+  auto segments_impl(std::index_sequence<Is...>) const
+  {
+    return std::array<std::string_view, sizeof...(Is)>{ segment<Is>()... };
+  }
+
+  template <std::size_t... Is>
+  char* copy_to_impl(char* out, std::index_sequence<Is...>) const
+  {
+    ((out = copy_segment<Is>(out)), ...);
+    return out;
+  }
+
+  template <std::size_t I>
+  char* copy_segment(char* out) const
+  {
+    constexpr auto info = segments_v[I];
+    const auto begin = std::next(m_buffer.data(), info.offset);
+
+    if constexpr (info.param == plain_segment) {
+      // Constant size, so the copy is inlined.
+      std::memcpy(out, begin, info.length);
+      return std::next(out, info.length);
+    } else {
+      const auto length = written_length<info.param>();
+      std::memcpy(out, begin, length);
+      return std::next(out, length);
+    }
+  }
+
+  unsigned written_length(unsigned n) const
+  {
+    if constexpr (track_written_v) {
+      return m_written[n];
+    } else {
+      return param_lengths_v[n];
+    }
+  }
+
+  std::string_view segment(const segment_info& info) const
+  {
+    const auto begin = std::next(m_buffer.data(), info.offset);
+    return { begin, info.param == plain_segment ? info.length
+                                                : written_length(info.param) };
+  }
+
+  template <std::size_t I>
+  std::string_view segment() const
+  {
+    constexpr auto info = segments_v[I];
+    const auto begin = std::next(m_buffer.data(), info.offset);
+
+    if constexpr (info.param == plain_segment) {
+      return { begin, info.length };
+    } else {
+      return { begin, written_length<info.param>() };
+    }
+  }
+
+  // `set` without updating CRCs, so that many params can be set before one
+  // update.
+  template <unsigned N, typename Value>
+  auto write(const Value& val)
+  {
+    using param_t = layout_param_t<S, N>;
+    using value_t = typename param_t::type_t;
+    static_assert(!is_derived_param_v<value_t>,
+                  "Length params, marks and checksums can't be set");
+    const auto param_buf = param_t::to_span(m_buffer);
+    char* end = nullptr;
+    auto overflow = false;
+    if constexpr (std::is_same_v<value_t, timestamp_param>) {
+      end = set_timestamp<N>(param_buf.begin(), static_cast<value_t>(val).ns);
+    } else {
+      end = write_number_slot<param_t>(param_buf.begin(),
+                                       static_cast<value_t>(val),
+                                       collect_stats_v ? &overflow : nullptr);
+    }
+    const auto cleared = clear_stale<N>(param_buf.begin(), end);
+    count_write<N>(param_buf.begin(), end, cleared, overflow);
+    after_set<N>();
+    return end;
+  }
+
+  template <unsigned N>
+  auto write(std::string_view value)
+  {
+    using param_t = layout_param_t<S, N>;
+    static_assert(!is_derived_param_v<typename param_t::type_t>,
+                  "Length params, marks and checksums can't be set");
+    const auto param_buf = param_t::to_span(m_buffer);
+    char* end = nullptr;
+    auto overflow = false;
+    if constexpr (std::is_same_v<typename param_t::type_t,
+                                 json_string_param>) {
+      end = write_json_string_slot<param_t>(
+        param_buf.begin(), value, collect_stats_v ? &overflow : nullptr);
+    } else {
+      end = write_string_slot<param_t>(param_buf.begin(), value);
+      overflow = value.size() > param_t::length_v;
+    }
+    const auto cleared = clear_stale<N>(param_buf.begin(), end);
+    count_write<N>(param_buf.begin(), end, cleared, overflow);
+    after_set<N>();
+    return end;
+  }
+
+  template <std::size_t... Is, typename... Values>
+  void set_all_impl(std::index_sequence<Is...>, const Values&... values)
+  {
+    (set_value<settable_indexes_v[Is]>(values), ...);
+  }
+
+  // `set` that picks the string overload for string params, so that any
+  // string-like value can be passed.
+  template <unsigned N, typename Value>
+  void set_value(const Value& val)
+  {
+    using param_t = layout_param_t<S, N>;
+
+    if constexpr (is_string_param_v<typename param_t::type_t>) {
+      write<N>(std::string_view{ val });
+    } else {
+      write<N, Value>(val);
+    }
+  }
+
+  // Writes only seconds and the fraction when `ns` is in the same minute as
+  // the previous value.
+  template <unsigned N>
+  char* set_timestamp(char* first, std::int64_t ns)
+  {
+    constexpr auto index = timestamp_indexes_v[N];
+    auto& minute_start = m_timestamp_minutes[index];
+
+    if (in_minute(minute_start, ns)) {
+      write_timestamp_seconds(
+        std::next(first, timestamp_minute_prefix_length), ns - *minute_start);
+    } else {
+      minute_start = write_timestamp(first, ns);
+    }
+
+    return std::next(first, 30);
+  }
+
+  // Adds `delta`, and `carry` to the last digit, to param `N` in place
+  template <unsigned N>
+  void add_with_carry(std::uint64_t delta, unsigned carry)
+  {
+    using param_t = layout_param_t<S, N>;
+    using value_t = typename param_t::type_t;
+    static_assert(std::is_integral_v<value_t> && std::is_unsigned_v<value_t> &&
+                    !std::is_same_v<value_t, bool>,
+                  "add and increment need an unsigned integer param");
+    static_assert(param_t::base_v == 10u,
+                  "add and increment need a decimal param");
+    static_assert(!is_digit(param_t::fill_v) ||
+                    (param_t::fill_v == '0' &&
+                     param_t::align_v == param_align::right),
+                  "add and increment need a non-digit fill, or zeros on the "
+                  "left");
+
+    constexpr auto right = param_t::align_v == param_align::right;
+    constexpr auto max_digits = max_chars_in_type<value_t>();
+    const auto param_buf = param_t::to_span(m_buffer);
+    const auto first = param_buf.begin();
+    // Right aligned values can grow into the fill. Others end where they
+    // end.
+    const auto number_end = right ? param_buf.end() : digits_end<N>(first);
+
+    auto pos = number_end;
+    while (delta != 0u) {
+      if (pos == first) {
+        return add_rewrite<N>(first, number_end, delta + carry);
+      }
+
+      --pos;
+      const auto digit = is_digit(*pos) ? static_cast<unsigned>(*pos - '0')
+                                        : 0u;
+      const auto sum = digit + static_cast<unsigned>(delta % 10u) + carry;
+      delta /= 10u;
+      *pos = static_cast<char>('0' + sum % 10u);
+      carry = sum / 10u;
+    }
+
+    // Only the carry is left. It stops at the first digit other than 9.
+    for (; carry != 0u; carry = 0u) {
+      for (; pos != first && *std::prev(pos) == '9'; --pos) {
+        *std::prev(pos) = '0';
+      }
+      if (pos == first) {
+        return add_rewrite<N>(first, number_end, 1u);
+      }
+
+      --pos;
+      *pos = is_digit(*pos) ? static_cast<char>(*pos + 1) : '1';
+    }
+
+    // Wrap around the maximum of the type, like the addition would do. A
+    // slot shorter than the maximum can't hold a value past it. Chars left
+    // of `pos` are as before, so usually the first digit tells it's fine.
+    if constexpr (param_t::length_v >= max_digits) {
+      const auto window =
+        std::prev(number_end,
+                  std::min<std::ptrdiff_t>(max_digits, number_end - first));
+      const auto nonzero = [](char c) { return c > '0' && c <= '9'; };
+      const auto past_max =
+        (pos <= window || nonzero(*window)) &&
+        (std::any_of(first, window, nonzero) ||
+         (number_end - window == max_digits &&
+          std::all_of(window, number_end, is_digit) &&
+          std::memcmp(window, max_value_digits<value_t>.data(), max_digits) >
+            0));
+      if (past_max) {
+        write<N>(static_cast<value_t>(parse_digits(first, number_end)));
+        return;
+      }
+    }
+
+    count_write<N>(first, number_end, 0u, false);
+    after_set<N>();
+  }
+
+  // Writes the value in [first, number_end) of param `N`, plus `delta` times
+  // ten to the power of its length. Used when the sum doesn't fit in place.
+  template <unsigned N>
+  void add_rewrite(char* first, char* number_end, std::uint64_t delta)
+  {
+    using value_t = typename layout_param_t<S, N>::type_t;
+
+    for (auto it = first; it != number_end; ++it) {
+      delta *= 10u;
+    }
+    write<N>(static_cast<value_t>(parse_digits(first, number_end) + delta));
+  }
+
+  // End of the digits of unaligned or left aligned param `N`
+  template <unsigned N>
+  char* digits_end(char* first) const
+  {
+    using param_t = layout_param_t<S, N>;
+
+    if constexpr (track_written_v && param_t::align_v == param_align::none) {
+      return std::next(first, m_written[N]);
+    } else {
+      return find_if(first, std::next(first, param_t::length_v),
+                     [](char c) { return !is_digit(c); });
+    }
+  }
+
+  // Called after every write to param `N`. Updates checksums that cover it.
+  template <unsigned N>
+  void after_set()
+  {
+    mark_dirty<N>();
+
+    if constexpr (in_any_range(fixsum_ranges_v, N)) {
+      const auto first = std::next(m_buffer.data(), slot_ranges_v[N].offset);
+      const auto length = written_length<N>();
+      auto sum = 0u;
+      for (auto i = 0u; i < length; ++i) {
+        sum += static_cast<unsigned char>(first[i]);
+      }
+
+      const auto delta = sum - m_param_sums[N];
+      m_param_sums[N] = sum;
+      if (delta != 0u) {
+        update_fixsums<N>(delta,
+                          std::make_index_sequence<fixsums_count_v>{});
+      }
+    }
+
+    if constexpr (in_any_range(crc_ranges_v, N)) {
+      if constexpr (patch_crcs_v) {
+        constexpr auto slot = slot_ranges_v[N];
+        const auto crc = crc32c_update(
+          0u, std::next(m_buffer.data(), slot.offset), slot.length);
+        const auto delta = crc ^ m_param_crcs[N];
+        m_param_crcs[N] = crc;
+        if (delta != 0u) {
+          patch_crcs<N>(delta, std::make_index_sequence<crcs_count_v>{});
+        }
+      } else {
+        m_stale_crcs |= crcs_covering(N);
+      }
+    }
+  }
+
+  template <unsigned N, std::size_t... Ks>
+  void patch_crcs(std::uint32_t delta, std::index_sequence<Ks...>)
+  {
+    (patch_crc<Ks, N>(delta), ...);
+  }
+
+  // Adds change `delta` of the CRC of param `N` to the CRC of `{crc32c}`
+  // param `K`, if its range contains param `N`
+  template <unsigned K, unsigned N>
+  void patch_crc(std::uint32_t delta)
+  {
+    constexpr auto range = crc_ranges_v[K];
+
+    if constexpr (range.first_param <= N && N < range.end_param) {
+      m_crcs[K] ^= crc_zeros_v<K, N>(delta);
+      m_stale_crcs |= std::uint64_t{ 1u } << K;
+    }
+  }
+
+  template <unsigned N, std::size_t... Ks>
+  void update_fixsums(unsigned delta, std::index_sequence<Ks...>)
+  {
+    (update_fixsum<Ks, N>(delta), ...);
+  }
+
+  // Adds `delta` to the sum of `{fixsum}` param `K`, if its range contains
+  // param `N`
+  template <unsigned K, unsigned N>
+  void update_fixsum(unsigned delta)
+  {
+    constexpr auto range = fixsum_ranges_v[K];
+
+    if constexpr (range.first_param <= N && N < range.end_param) {
+      m_fixsums[K] += delta;
+      m_stale_fixsums |= std::uint64_t{ 1u } << K;
+    }
+  }
+
+  // Bit of every `{crc32c}` param which range contains param `n`
+  static constexpr std::uint64_t crcs_covering(unsigned n)
+  {
+    auto mask = std::uint64_t{};
+    for (auto k = 0u; k < crcs_count_v; ++k) {
+      const auto& range = crc_ranges_v[k];
+      if (range.first_param <= n && n < range.end_param) {
+        mask |= std::uint64_t{ 1u } << k;
+      }
+    }
+    return mask;
+  }
+
+  // Writes checksums with a changed param in the range. Sums of `{fixsum}`
+  // params are updated with every write, and so are CRCs of fixed layouts.
+  // With `track_written` chars move with lengths of params, so a CRC is
+  // computed again. Done once at the end of every public `set*`, so that
+  // setting many params writes checksums once.
+  void update_checksums()
+  {
+    if constexpr (fixsums_count_v + crcs_count_v != 0u) {
+      // A checksum can be in the range of another one
+      while ((m_stale_fixsums | m_stale_crcs) != 0u) {
+        write_stale_fixsums(std::make_index_sequence<fixsums_count_v>{});
+        update_stale_crcs(std::make_index_sequence<crcs_count_v>{});
+      }
+    }
+  }
+
+  template <std::size_t... Ks>
+  void write_stale_fixsums(std::index_sequence<Ks...>)
+  {
+    (write_fixsum<Ks>(), ...);
+  }
+
+  template <unsigned K>
+  void write_fixsum()
+  {
+    constexpr auto bit = std::uint64_t{ 1u } << K;
+    if ((m_stale_fixsums & bit) == 0u) {
+      return;
+    }
+    m_stale_fixsums &= ~bit;
+
+    write_fixsum_digits<K>(m_buffer.data(), m_fixsums[K]);
+    count_slot_write<fixsum_ranges_v[K].param>();
+    after_set<fixsum_ranges_v[K].param>();
   }
 
-  decltype(auto) operator[](unsigned n) { return m_buffer[n]; }
+  // Writes `sum` modulo 256 to `{fixsum}` param `K` of `message`
+  template <unsigned K>
+  static void write_fixsum_digits(char* message, unsigned sum)
+  {
+    constexpr auto slot = slot_ranges_v[fixsum_ranges_v[K].param];
+    write_fixed_digits_backward<3u>(
+      std::next(message, slot.offset + slot.length), sum % 256u);
+  }
 
-  constexpr auto to_string_view() const
+  // Writes `crc` to `{crc32c}` param `K` of `message`
+  template <unsigned K>
+  static void write_crc_digits(char* message, std::uint32_t crc)
   {
-    return std::string_view{ m_buffer.data(), m_buffer.size() };
+    constexpr auto param = crc_ranges_v[K].param;
+    constexpr auto slot = slot_ranges_v[param];
+    constexpr auto digits =
+      layout_param_t<S, param>::uppercase_v ? upper_digits : lower_digits;
+
+    auto end = std::next(message, slot.offset + slot.length);
+    for (auto i = 0u; i < 8u; ++i, crc >>= 4u) {
+      *--end = digits[crc & 0xfu];
+    }
   }
 
-private:
-  std::tuple<Params...> m_params{};
-  decltype(make_buffer(S{})) m_buffer = make_buffer(S{});
+  template <std::size_t... Ks>
+  void update_stale_crcs(std::index_sequence<Ks...>)
+  {
+    (update_crc<Ks>(), ...);
+  }
+
+  template <unsigned K>
+  void update_crc()
+  {
+    constexpr auto bit = std::uint64_t{ 1u } << K;
+    if ((m_stale_crcs & bit) == 0u) {
+      return;
+    }
+    m_stale_crcs &= ~bit;
+
+    constexpr auto range = crc_ranges_v[K];
+    if constexpr (patch_crcs_v) {
+      write_crc_digits<K>(m_buffer.data(), m_crcs[K]);
+    } else {
+      // Parts are short, so they are gathered first. Then `crc32c_update`
+      // goes 8 chars at a time.
+      char compact[range.end - range.begin + 1u];
+      constexpr auto params_count = range.end_param - range.first_param;
+      const auto compact_end =
+        gather_range<K>(compact, std::make_index_sequence<params_count>{});
+      const auto crc = ~crc32c_update(
+        ~std::uint32_t{}, compact,
+        static_cast<std::size_t>(compact_end - compact));
+      write_crc_digits<K>(m_buffer.data(), crc);
+    }
+    count_slot_write<range.param>();
+    after_set<range.param>();
+  }
+
+  // Copies output in the range of `{crc32c}` param `K` to `out`, like
+  // `copy_to`. Whole slots are copied, with constant sizes, and `out`
+  // advances by the written part only.
+  template <unsigned K, std::size_t... Is>
+  char* gather_range(char* out, std::index_sequence<Is...>) const
+  {
+    constexpr auto range = crc_ranges_v[K];
+    ((out = gather_param<K, range.first_param + Is>(out)), ...);
+
+    constexpr auto tail_begin =
+      range.end_param == range.first_param
+        ? range.begin
+        : slot_ranges_v[range.end_param - 1u].offset +
+            slot_ranges_v[range.end_param - 1u].length;
+    std::memcpy(out, std::next(m_buffer.data(), tail_begin),
+                range.end - tail_begin);
+    return std::next(out, range.end - tail_begin);
+  }
+
+  template <unsigned K, unsigned N>
+  char* gather_param(char* out) const
+  {
+    constexpr auto range = crc_ranges_v[K];
+    constexpr auto slot = slot_ranges_v[N];
+    constexpr auto plain_begin =
+      N == range.first_param
+        ? range.begin
+        : slot_ranges_v[N - 1u].offset + slot_ranges_v[N - 1u].length;
+
+    std::memcpy(out, std::next(m_buffer.data(), plain_begin),
+                slot.offset - plain_begin);
+    std::advance(out, slot.offset - plain_begin);
+    std::memcpy(out, std::next(m_buffer.data(), slot.offset), slot.length);
+    return std::next(out, written_length<N>());
+  }
+
+  template <unsigned N>
+  void mark_dirty()
+  {
+    if constexpr (track_dirty_v) {
+      m_dirty.set(N);
+    }
+  }
+
+  // Fills chars of the previous value, that are past the new value's `end`.
+  // Returns the number of filled chars.
+  template <unsigned N>
+  unsigned clear_stale(char* first, char* end)
+  {
+    using param_t = layout_param_t<S, N>;
+
+    // Aligned params overwrite the whole slot on every set.
+    if constexpr (track_written_v && param_t::align_v == param_align::none) {
+      const auto stale_end = std::next(first, m_written[N]);
+      auto cleared = 0u;
+      if (end < stale_end) {
+        std::fill(end, stale_end, param_t::fill_v);
+        cleared = static_cast<unsigned>(stale_end - end);
+      }
+      set_written<N>(static_cast<unsigned>(end - first));
+      return cleared;
+    } else {
+      return 0u;
+    }
+  }
+
+  // Counts a write of param `N` to the slot at `first`, whose value or, for
+  // right aligned params, the slot ends at `end`. `cleared` chars past it
+  // were filled. Used with `collect_stats`.
+  template <unsigned N>
+  void count_write(char* first, char* end, unsigned cleared, bool overflow,
+                   char fill = layout_param_t<S, N>::fill_v)
+  {
+    if constexpr (collect_stats_v) {
+      using param_t = layout_param_t<S, N>;
+      auto written = static_cast<std::uint64_t>(end - first);
+      auto filled = std::uint64_t{ cleared };
+
+      if constexpr (param_t::align_v == param_align::right) {
+        // Zeros go between the minus and the digits, and a point follows
+        // at least one digit. A value has at least one char.
+        const auto sign = *first == '-' && fill != '-' ? 1 : 0;
+        auto value_begin = find_if(std::next(first, sign), std::prev(end),
+                                   [fill](char c) { return c != fill; });
+        if (*value_begin == '.') {
+          --value_begin;
+        }
+        written = static_cast<std::uint64_t>(end - value_begin) + sign;
+        filled = param_t::length_v - written;
+      } else if constexpr (param_t::align_v == param_align::left) {
+        filled = param_t::length_v - written;
+      }
+
+      auto& stats = m_stats[N];
+      ++stats.writes;
+      stats.overflows += overflow;
+      stats.bytes_written += written;
+      stats.bytes_filled += filled;
+    }
+  }
+
+  // `count_write` of a checksum, which fills its whole slot
+  template <unsigned N>
+  void count_slot_write()
+  {
+    constexpr auto slot = slot_ranges_v[N];
+    const auto first = std::next(m_buffer.data(), slot.offset);
+    count_write<N>(first, std::next(first, slot.length), 0u, false);
+  }
+
+  // Records new length of unaligned param `N` and updates the length params
+  // that count it.
+  template <unsigned N>
+  void set_written(unsigned length)
+  {
+    const auto delta = length - m_written[N];
+    m_written[N] = length;
+
+    if constexpr (length_params_count_v > 0u) {
+      if (delta != 0u) {
+        update_lengths<N>(
+          delta, std::make_index_sequence<length_params_count_v>{});
+      }
+    }
+  }
+
+  template <unsigned N, std::size_t... Ks>
+  void update_lengths(unsigned delta, std::index_sequence<Ks...>)
+  {
+    (update_length<Ks, N>(delta), ...);
+  }
+
+  // Adds `delta` to length param `K`, if its range contains param `N`
+  template <unsigned K, unsigned N>
+  void update_length(unsigned delta)
+  {
+    constexpr auto range = length_ranges_v[K];
+
+    if constexpr (range.first_param <= N && N < range.end_param) {
+      constexpr auto index = range.param;
+      using param_t = layout_param_t<S, index>;
+      const auto param_buf = param_t::to_span(m_buffer);
+
+      m_lengths[K] += delta;
+      const auto end =
+        write_number_slot<param_t>(param_buf.begin(), m_lengths[K]);
+      const auto cleared = clear_stale<index>(param_buf.begin(), end);
+      count_write<index>(param_buf.begin(), end, cleared, false);
+      after_set<index>();
+    }
+  }
+
+  buffer_t m_buffer = image_v;
+  // Length of the current value of every param. Used with `track_written`.
+  std::array<unsigned, track_written_v ? sizeof...(Params) : 0u> m_written =
+    initial_written();
+  // Params set since the last `take_dirty`. Used with `track_dirty`.
+  std::bitset<track_dirty_v ? sizeof...(Params) : 0u> m_dirty;
+  // Counters of every param. Used with `collect_stats`.
+  std::array<param_stats, collect_stats_v ? sizeof...(Params) : 0u> m_stats{};
+  // Current value of every length param
+  std::array<unsigned, length_params_count_v> m_lengths = initial_lengths_v;
+  // Sums of bytes of params and of ranges of `{fixsum}` params
+  std::array<unsigned, initial_param_sums_v.size()> m_param_sums =
+    initial_param_sums_v;
+  std::array<unsigned, fixsums_count_v> m_fixsums = initial_fixsums_v;
+  // CRCs of params and of ranges of `{crc32c}` params, when they are patched
+  std::array<std::uint32_t, initial_param_crcs_v.size()> m_param_crcs =
+    initial_param_crcs_v;
+  std::array<std::uint32_t, initial_crcs_v.size()> m_crcs = initial_crcs_v;
+  // Checksum params to write again, a bit per param of each kind
+  std::uint64_t m_stale_fixsums{};
+  std::uint64_t m_stale_crcs{};
+  // Start of the minute written in every timestamp param
+  std::array<minute_start_t, timestamps_count_v> m_timestamp_minutes{};
+
+  static constexpr auto initial_written()
+  {
+    if constexpr (track_written_v) {
+      return initial_written_v;
+    } else {
+      return std::array<unsigned, 0u>{};
+    }
+  }
 };
 
 template <typename S, std::string_view::size_type FullLength,
-          typename... Params>
+          typename... Params, typename... Options>
 constexpr auto make_formatter_impl(
-  format_info<S, FullLength, types<Params...>>)
+  format_info<S, FullLength, types<Params...>>, types<Options...>)
+  -> formatter<S, types<Options...>, Params...>
 {
-  return formatter<S, Params...>{};
+  return formatter<S, types<Options...>, Params...>{};
 }
 }
 
-template <typename S>
-constexpr auto make_formatter(S)
+template <typename S, typename... Options>
+constexpr auto make_formatter(S, Options...)
+{
+  constexpr auto info = details::collect_format_info(S{});
+  return details::make_formatter_impl(info, details::types<Options...>{});
+}
+
+// Formatter that keeps the message in memory given by the caller, e.g. shared
+// memory or a registered IO buffer, instead of a member array. Every `set`
+// writes directly there. Views can be moved, but not copied or default
+// constructed.
+template <typename S, typename... Options>
+using formatter_view = decltype(details::make_formatter_impl(
+  details::collect_format_info(S{}),
+  details::types<Options..., details::external_memory_t>{}));
+
+namespace details {
+template <typename T>
+struct is_std_array : std::false_type
+{
+};
+
+template <typename T, std::size_t Size>
+struct is_std_array<std::array<T, Size>> : std::true_type
+{
+};
+}
+
+// Writes the message template to `memory` and returns a view formatting
+// there. `memory` is a char array or `std::array<char, N>`, which size is
+// checked at compile time, or `char*` that must have room for
+// `formatter_view<S, Options...>::size()` chars.
+template <typename S, typename Memory, typename... Options>
+auto make_formatter_view(S, Memory&& memory, Options...)
+{
+  using view_t = formatter_view<S, Options...>;
+  using memory_t = std::remove_reference_t<Memory>;
+
+  if constexpr (std::is_array_v<memory_t>) {
+    static_assert(std::extent_v<memory_t> >= view_t::size(),
+                  "Memory too small for the format");
+    return view_t{ memory };
+  } else if constexpr (details::is_std_array<memory_t>::value) {
+    static_assert(std::tuple_size_v<memory_t> >= view_t::size(),
+                  "Memory too small for the format");
+    return view_t{ memory.data() };
+  } else {
+    return view_t{ static_cast<char*>(memory) };
+  }
+}
+
+// `N` formatters of the same format, to format the next message while
+// the previous ones are still being sent. Every slot is a ready formatter with
+// the same param offsets, so a slot index is all that's needed.
+// `acquire` and `operator[]` are meant for the formatting thread. `release`
+// may be called from any thread, e.g. on a send completion.
+template <typename Formatter, unsigned N>
+class formatter_pool
+{
+public:
+  static_assert(N > 0u, "Pool needs at least one formatter");
+
+  static constexpr auto npos = std::numeric_limits<unsigned>::max();
+
+  formatter_pool() = default;
+  formatter_pool(const formatter_pool&) = delete;
+  formatter_pool& operator=(const formatter_pool&) = delete;
+
+  static constexpr unsigned size() { return N; }
+
+  // Marks the next free slot, in round-robin order, as in flight and returns
+  // its index. Returns `npos` when all slots are in flight.
+  unsigned acquire()
+  {
+    for (auto i = 0u; i < N; ++i) {
+      const auto index = (m_next + i) % N;
+      if (!m_in_flight[index].load(std::memory_order_acquire)) {
+        m_in_flight[index].store(true, std::memory_order_relaxed);
+        m_next = (index + 1u) % N;
+        return index;
+      }
+    }
+
+    return npos;
+  }
+
+  // Gives the slot back, e.g. once the kernel no longer references its
+  // buffer. The slot keeps its content.
+  void release(unsigned index)
+  {
+    m_in_flight[index].store(false, std::memory_order_release);
+  }
+
+  bool in_flight(unsigned index) const
+  {
+    return m_in_flight[index].load(std::memory_order_acquire);
+  }
+
+  unsigned in_flight_count() const
+  {
+    auto count = 0u;
+    for (const auto& flag : m_in_flight) {
+      count += flag.load(std::memory_order_relaxed);
+    }
+    return count;
+  }
+
+  Formatter& operator[](unsigned index) { return m_formatters[index]; }
+  const Formatter& operator[](unsigned index) const
+  {
+    return m_formatters[index];
+  }
+
+private:
+  // Every formatter starts with the buffer image prepared at compile time
+  std::array<Formatter, N> m_formatters{};
+  std::array<std::atomic<bool>, N> m_in_flight{};
+  unsigned m_next = 0u;
+};
+
+template <unsigned N, typename S, typename... Options>
+auto make_formatter_pool(S, Options...)
+{
+  using formatter_t = decltype(make_formatter(S{}, Options{}...));
+  return formatter_pool<formatter_t, N>{};
+}
+
+namespace details {
+// Hints the CPU that the thread spins, e.g. `pause` on x86, so that a reader
+// waiting for a writer yields the core to its sibling hyperthread and leaves
+// the spin loop without a memory order violation flush.
+inline void spin_pause()
 {
-  constexpr auto info = details::collect_format_info<0u, 0u>(S{});
-  return details::make_formatter_impl(info);
+#if defined(__SSE2__)
+  _mm_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+}
+
+// Formatter shared by one writer and many readers through a seqlock. The
+// writer never waits. Readers copy the buffer and retry if an update was
+// in progress, so they always get a consistent message.
+template <typename Formatter>
+class seqlock_formatter
+{
+public:
+  seqlock_formatter() = default;
+  seqlock_formatter(const seqlock_formatter&) = delete;
+  seqlock_formatter& operator=(const seqlock_formatter&) = delete;
+
+  // Size of the message that `read` copies.
+  static constexpr auto size() { return Formatter::size(); }
+
+  // Calls `write(formatter)`, e.g. to set a couple of params, and publishes
+  // the result as one update. Writer thread only.
+  template <typename Write>
+  void update(Write&& write)
+  {
+    const auto seq = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(seq + 1u, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    write(m_formatter);
+
+    m_seq.store(seq + 2u, std::memory_order_release);
+  }
+
+  template <unsigned N, typename Value>
+  void set(const Value& val)
+  {
+    update([&val](Formatter& f) { f.template set<N>(val); });
+  }
+
+  // Copies the last published message to `out`, which must have room for
+  // `size()` chars. Returns pointer past the last copied char.
+  char* read(char* out) const
+  {
+    const auto view = m_formatter.to_string_view();
+
+    while (true) {
+      const auto seq = m_seq.load(std::memory_order_acquire);
+      if (seq % 2u == 0u) {
+        std::memcpy(out, view.data(), view.size());
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (m_seq.load(std::memory_order_relaxed) == seq) {
+          return std::next(out, view.size());
+        }
+      }
+
+      // An update is in progress
+      details::spin_pause();
+    }
+  }
+
+private:
+  // Odd while an update is in progress
+  std::atomic<unsigned> m_seq{ 0u };
+  Formatter m_formatter{};
+};
+
+template <typename S, typename... Options>
+auto make_seqlock_formatter(S, Options...)
+{
+  using formatter_t = decltype(make_formatter(S{}, Options{}...));
+  return seqlock_formatter<formatter_t>{};
+}
+
+namespace details {
+// Slot of a param of a `runtime_formatter` and how values are written there
+struct runtime_param
+{
+  param_kind kind{};
+  unsigned offset{};
+  unsigned length{};
+  format_spec spec{};
+};
+
+// Calls `f` with `type_tag` of values of params of `kind`, so that runtime
+// formatting picks the same writers as compile time formatting.
+template <typename F>
+decltype(auto) visit_kind(param_kind kind, F&& f)
+{
+  switch (kind) {
+    case param_kind::bool_:
+      return f(kind_type_tag<param_kind::bool_>());
+    case param_kind::char_:
+      return f(kind_type_tag<param_kind::char_>());
+    case param_kind::signed_char:
+      return f(kind_type_tag<param_kind::signed_char>());
+    case param_kind::unsigned_char:
+      return f(kind_type_tag<param_kind::unsigned_char>());
+    case param_kind::short_int:
+      return f(kind_type_tag<param_kind::short_int>());
+    case param_kind::unsigned_short_int:
+      return f(kind_type_tag<param_kind::unsigned_short_int>());
+    case param_kind::int_:
+      return f(kind_type_tag<param_kind::int_>());
+    case param_kind::unsigned_int:
+      return f(kind_type_tag<param_kind::unsigned_int>());
+    case param_kind::long_int:
+      return f(kind_type_tag<param_kind::long_int>());
+    case param_kind::unsigned_long_int:
+      return f(kind_type_tag<param_kind::unsigned_long_int>());
+    case param_kind::long_long_int:
+      return f(kind_type_tag<param_kind::long_long_int>());
+    case param_kind::unsigned_long_long_int:
+      return f(kind_type_tag<param_kind::unsigned_long_long_int>());
+    case param_kind::float_:
+      return f(kind_type_tag<param_kind::float_>());
+    case param_kind::double_:
+      return f(kind_type_tag<param_kind::double_>());
+    case param_kind::long_double:
+      return f(kind_type_tag<param_kind::long_double>());
+    case param_kind::uint8:
+      return f(kind_type_tag<param_kind::uint8>());
+    case param_kind::int8:
+      return f(kind_type_tag<param_kind::int8>());
+    case param_kind::uint16:
+      return f(kind_type_tag<param_kind::uint16>());
+    case param_kind::int16:
+      return f(kind_type_tag<param_kind::int16>());
+    case param_kind::uint32:
+      return f(kind_type_tag<param_kind::uint32>());
+    case param_kind::int32:
+      return f(kind_type_tag<param_kind::int32>());
+    case param_kind::uint64:
+      return f(kind_type_tag<param_kind::uint64>());
+    case param_kind::int64:
+      return f(kind_type_tag<param_kind::int64>());
+    case param_kind::str:
+      return f(kind_type_tag<param_kind::str>());
+    case param_kind::jstr:
+      return f(kind_type_tag<param_kind::jstr>());
+    case param_kind::timestamp_ns:
+      return f(kind_type_tag<param_kind::timestamp_ns>());
+    case param_kind::dec64:
+      return f(kind_type_tag<param_kind::dec64>());
+    case param_kind::len:
+      return f(kind_type_tag<param_kind::len>());
+    case param_kind::mark:
+      return f(kind_type_tag<param_kind::mark>());
+    case param_kind::fixsum:
+      return f(kind_type_tag<param_kind::fixsum>());
+    case param_kind::crc32c:
+      return f(kind_type_tag<param_kind::crc32c>());
+  }
+
+  // Not a kind
+  return f(type_tag<mark_param>{});
+}
+
+template <std::size_t... Scales>
+inline char* write_decimal(char* first, std::int64_t mantissa, unsigned scale,
+                           std::index_sequence<Scales...>)
+{
+  auto end = first;
+  ((scale == Scales && (end = write_decimal<Scales>(first, mantissa))) ||
+   ...);
+  return end;
+}
+
+// `write_number` with the spec known at runtime. Picks the writer of the
+// base or scale, so values are written as fast as with a compile time spec.
+template <typename T>
+inline char* write_number(char* first, char* last, T value,
+                          const format_spec& spec)
+{
+  if constexpr (std::is_same_v<T, bool>) {
+    std::memcpy(first, &"truefalse"[4u * !value], 4u + !value);
+    return std::next(first, 4u + !value);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    return write_floating(first, last, value, spec.precision);
+  } else if constexpr (std::is_same_v<T, decimal_param>) {
+    return write_decimal(first, value.mantissa, spec.precision,
+                         std::make_index_sequence<20u>{});
+  } else {
+    switch (spec.base) {
+      case 16u:
+        return spec.uppercase ? write_integer<16u, true>(first, value)
+                              : write_integer<16u>(first, value);
+      case 8u:
+        return write_integer<8u>(first, value);
+      case 2u:
+        return write_integer<2u>(first, value);
+      default:
+        return write_integer(first, value);
+    }
+  }
+}
+}
+
+// Formatter of a format string known only at runtime, e.g. loaded from
+// a config at startup. The string is parsed once, with the grammar of
+// compile time formatters, into a table of slots and the message template.
+// `set` writes into a slot with the same writers, after a switch on the
+// param's kind, and doesn't allocate. Works like a formatter with
+// `track_written`. Length, mark and checksum params are not supported.
+class runtime_formatter
+{
+public:
+  static constexpr auto npos = std::numeric_limits<unsigned>::max();
+
+  std::size_t size() const { return m_buffer.size(); }
+
+  unsigned params_count() const
+  {
+    return static_cast<unsigned>(m_params.size());
+  }
+
+  // Index of the param named `name`, or `npos` if there is none.
+  unsigned index_of(std::string_view name) const
+  {
+    for (auto n = 0u; n < m_names.size(); ++n) {
+      if (!name.empty() && m_names[n] == name) {
+        return n;
+      }
+    }
+    return npos;
+  }
+
+  // Writes `value` to param `n`, converted to the param's type. Returns
+  // pointer past the last written char, or `nullptr` if there is no param
+  // `n`, e.g. `npos` of `index_of`, or it doesn't take numbers, e.g.
+  // `{str8}`. Integers are taken as the mantissa by `{dec64.N}` and as
+  // nanoseconds by `{timestamp_ns}`.
+  template <typename T, std::enable_if_t<std::is_arithmetic_v<T>, int> = 0>
+  char* set(unsigned n, T value)
+  {
+    if (n >= m_params.size()) {
+      return nullptr;
+    }
+    const auto& param = m_params[n];
+    const auto first = std::next(m_buffer.data(), param.offset);
+    const auto end = details::visit_kind(param.kind, [&](auto tag) -> char* {
+      using value_t = typename decltype(tag)::type;
+
+      if constexpr (std::is_same_v<value_t, details::timestamp_param> ||
+                    std::is_same_v<value_t, details::decimal_param>) {
+        if constexpr (std::is_integral_v<T>) {
+          return write(n, first, value_t{ static_cast<std::int64_t>(value) });
+        } else {
+          return nullptr;
+        }
+      } else if constexpr (std::is_arithmetic_v<value_t>) {
+        return write(n, first, static_cast<value_t>(value));
+      } else {
+        return nullptr;
+      }
+    });
+
+    return end == nullptr ? nullptr : finish(n, first, end);
+  }
+
+  // Writes `value` to string param `n`. Returns pointer past the last
+  // written char, or `nullptr` if there is no param `n` or it's not a string
+  // param.
+  char* set(unsigned n, std::string_view value)
+  {
+    if (n >= m_params.size()) {
+      return nullptr;
+    }
+    const auto& param = m_params[n];
+    const auto first = std::next(m_buffer.data(), param.offset);
+    const auto last = std::next(first, param.length);
+    char* end = nullptr;
+
+    if (param.kind == details::param_kind::str) {
+      value = value.substr(0u, param.length);
+      std::memcpy(first, value.data(), value.size());
+      end = std::next(first, value.size());
+    } else if (param.kind == details::param_kind::jstr) {
+      end = details::write_json_escaped(first, last, value);
+    } else {
+      return nullptr;
+    }
+
+    return finish(n, first, end);
+  }
+
+  template <typename Clock, typename Duration>
+  char* set(unsigned n, std::chrono::time_point<Clock, Duration> time)
+  {
+    if (n >= m_params.size() ||
+        m_params[n].kind != details::param_kind::timestamp_ns) {
+      return nullptr;
+    }
+    return set(n, details::timestamp_param{ time }.ns);
+  }
+
+  // Offset and length of the slot of param `n` in the buffer.
+  details::byte_range slot_range(unsigned n) const
+  {
+    return { m_params[n].offset, m_params[n].length };
+  }
+
+  unsigned written_length(unsigned n) const { return m_written[n]; }
+
+  // Copies plain text and written parts of the params to `out`, like
+  // `formatter::copy_to`. Returns pointer past the last copied char.
+  char* copy_to(char* out) const
+  {
+    auto offset = 0u;
+
+    for (auto n = 0u; n < m_params.size(); ++n) {
+      const auto& param = m_params[n];
+      std::memcpy(out, &m_buffer[offset], param.offset - offset);
+      std::advance(out, param.offset - offset);
+      std::memcpy(out, &m_buffer[param.offset], m_written[n]);
+      std::advance(out, m_written[n]);
+      offset = param.offset + param.length;
+    }
+
+    std::memcpy(out, &m_buffer[offset], m_buffer.size() - offset);
+    return std::next(out, m_buffer.size() - offset);
+  }
+
+  // Number of chars that `copy_to` copies.
+  unsigned compact_size() const
+  {
+    auto size = static_cast<unsigned>(m_buffer.size());
+    for (auto n = 0u; n < m_params.size(); ++n) {
+      size -= m_params[n].length - m_written[n];
+    }
+    return size;
+  }
+
+  std::string_view to_string_view() const
+  {
+    return { m_buffer.data(), m_buffer.size() };
+  }
+
+private:
+  friend std::optional<runtime_formatter> make_runtime_formatter(
+    std::string_view format);
+
+  runtime_formatter() = default;
+
+  template <typename T>
+  char* write(unsigned n, char* first, T value)
+  {
+    const auto& param = m_params[n];
+    const auto last = std::next(first, param.length);
+
+    if constexpr (std::is_same_v<T, details::timestamp_param>) {
+      // Only seconds and the fraction change within a minute
+      auto& minute_start = m_timestamp_minutes[n];
+      if (details::in_minute(minute_start, value.ns)) {
+        details::write_timestamp_seconds(
+          std::next(first, details::timestamp_minute_prefix_length),
+          value.ns - *minute_start);
+      } else {
+        minute_start = details::write_timestamp(first, value.ns);
+      }
+      return std::next(first, 30);
+    } else {
+      return details::write_number(first, last, value, param.spec);
+    }
+  }
+
+  // Aligns the value written at the beginning of slot of param `n`, or
+  // fills chars of the previous value past `end`. Returns pointer past the
+  // value.
+  char* finish(unsigned n, char* first, char* end)
+  {
+    const auto& param = m_params[n];
+
+    switch (param.spec.align) {
+      case details::param_align::right:
+        // Strings are text, a leading minus isn't a sign
+        if (param.kind == details::param_kind::str ||
+            param.kind == details::param_kind::jstr) {
+          return details::move_to_slot_end(first, end, param.length,
+                                           param.spec.fill);
+        }
+        return details::align_right(first, end, param.length,
+                                    param.spec.fill);
+      case details::param_align::left:
+        std::memset(end, param.spec.fill, param.length - (end - first));
+        return end;
+      case details::param_align::none:
+        break;
+    }
+
+    const auto stale_end = std::next(first, m_written[n]);
+    if (end < stale_end) {
+      std::memset(end, param.spec.fill, stale_end - end);
+    }
+    m_written[n] = static_cast<unsigned>(end - first);
+    return end;
+  }
+
+  std::vector<details::runtime_param> m_params;
+  // Empty for unnamed params
+  std::vector<std::string> m_names;
+  std::vector<char> m_buffer;
+  std::vector<unsigned> m_written;
+  // Start of the minute written in every `{timestamp_ns}` param
+  std::vector<details::minute_start_t> m_timestamp_minutes;
+};
+
+// Parses `format` into a `runtime_formatter`. Returns nothing if `format` has
+// an unknown param, an unsupported one or two params of the same name.
+inline std::optional<runtime_formatter> make_runtime_formatter(
+  std::string_view format)
+{
+  using namespace details;
+
+  runtime_formatter result;
+  std::vector<param_descriptor> descriptors;
+  auto full_length = 0u;
+
+  for (auto pos = 0u; pos < format.size();) {
+    const auto token = next_token(format, pos);
+
+    if (token.kind == token_kind::param) {
+      const auto param = describe_param(format, pos, full_length);
+      const auto supported =
+        param.kind && *param.kind != param_kind::len &&
+        *param.kind != param_kind::mark &&
+        *param.kind != param_kind::fixsum &&
+        *param.kind != param_kind::crc32c &&
+        (*param.kind != param_kind::dec64 || param.spec.precision <= 19u) &&
+        (*param.kind != param_kind::timestamp_ns ||
+         (param.spec.align == param_align::none && param.length == 30u));
+      const auto duplicate = result.index_of(param.name) != result.npos;
+      if (!supported || duplicate) {
+        return std::nullopt;
+      }
+
+      descriptors.push_back(param);
+      result.m_params.push_back(
+        { *param.kind, full_length, param.length, param.spec });
+      result.m_names.emplace_back(param.name);
+      result.m_written.push_back(
+        param.spec.align == param_align::none ? 0u : param.length);
+      full_length += param.length;
+    } else {
+      full_length += token.length;
+    }
+
+    pos += token.size;
+  }
+
+  result.m_buffer.resize(full_length);
+  auto buffer = span<char>{ result.m_buffer.data(), full_length };
+  fill_buffer(format, descriptors, buffer);
+  result.m_timestamp_minutes.resize(result.m_params.size());
+  return result;
 }
 }
@@ -1,9 +1,13 @@
 #include "infmt.hpp"
 
 #include <cassert>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <limits.h>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 template <class T>
 struct dependent_false : std::false_type
@@ -65,9 +69,16 @@ int main()
   static_assert(infmt::details::calc_size("{signed char}") == 4u);
   static_assert(infmt::details::calc_size("{unsigned char}") == 3u);
 
-  static_assert(infmt::details::calc_size("{float}") == 48u);
-  static_assert(infmt::details::calc_size("{double}") == 327u);
-  static_assert(infmt::details::calc_size("{long double}") == 4954u);
+  static_assert(infmt::details::calc_size("{float}") == 15u);
+  static_assert(infmt::details::calc_size("{double}") == 24u);
+  static_assert(infmt::details::calc_size("{double:.6}") == 24u);
+  static_assert(infmt::details::calc_size("{double:32.6}") == 32u);
+  static_assert(infmt::details::calc_size("{double:.30}") == 33u);
+  static_assert(infmt::details::calc_size("{long double}") ==
+                infmt::details::max_chars_in_floating_type<long double>());
+  // x87 extended precision, e.g. -3.36210314311209350626e-4932
+  static_assert(std::numeric_limits<long double>::digits != 64 ||
+                infmt::details::calc_size("{long double}") == 29u);
 
   static_assert(infmt::details::calc_size("{uint8_t}") == 3);
   static_assert(infmt::details::calc_size("{int8_t}") == 4);
@@ -86,6 +97,12 @@ int main()
   static_assert(infmt::details::calc_size("{str10}") == 10u);
   static_assert(infmt::details::calc_size("{str1234567890}") == 1234567890u);
 
+  static_assert(infmt::details::calc_size("{uint32_t:>}") == 10);
+  static_assert(infmt::details::calc_size("{int64_t:0>}") == 20);
+  static_assert(infmt::details::calc_size("{str10:*<}") == 10u);
+  static_assert(infmt::details::calc_size("{uint8_t:>8}") == 8u);
+  static_assert(infmt::details::calc_size("{uint32_t:4}") == 10u);
+
   // Test wchar_t
   // const auto wchar_tester = [](auto val) {
   //   using value_t = decltype(val);
@@ -366,11 +383,33 @@ int main()
                                                   0, 0, 1234567890, 15u>,
                      decltype(infmt::details::format_param_from<0u>(s))>);
   }
+  {
+    using infmt::details::param_align;
+    using infmt::details::param_spec;
+
+    constexpr auto s = INFMT_STRING("{uint32_t:0>}");
+    static_assert(std::is_same_v<
+                  infmt::details::format_param<std::uint32_t, 0, 0, 10, 13u,
+                                               param_spec<param_align::right,
+                                                          '0'>>,
+                  decltype(infmt::details::format_param_from<0u>(s))>);
+  }
+  {
+    using infmt::details::param_align;
+    using infmt::details::param_spec;
+
+    constexpr auto s = INFMT_STRING("{str8:<}");
+    static_assert(
+      std::is_same_v<infmt::details::format_param<
+                       infmt::details::string_param, 0, 0, 8, 8u,
+                       param_spec<param_align::left, ' '>>,
+                     decltype(infmt::details::format_param_from<0u>(s))>);
+  }
 
   // collecting params
   {
     constexpr auto s = INFMT_STRING("");
-    constexpr auto result = infmt::details::collect_format_info<0u>(s);
+    constexpr auto result = infmt::details::collect_format_info(s);
     using result_t = std::remove_cv_t<decltype(result)>;
     using expected_params_t = infmt::details::types<>;
 
@@ -380,7 +419,7 @@ int main()
   }
   {
     constexpr auto s = INFMT_STRING("{uint8_t}");
-    constexpr auto result = infmt::details::collect_format_info<0u>(s);
+    constexpr auto result = infmt::details::collect_format_info(s);
     using result_t = std::remove_cv_t<decltype(result)>;
     using expected_params_t = infmt::details::types<
       infmt::details::format_param<std::uint8_t, 0, 0, 3, 9u>>;
@@ -391,7 +430,7 @@ int main()
   }
   {
     constexpr auto s = INFMT_STRING("{uint8_t}{int8_t}");
-    constexpr auto result = infmt::details::collect_format_info<0u>(s);
+    constexpr auto result = infmt::details::collect_format_info(s);
     using result_t = std::remove_cv_t<decltype(result)>;
     using expected_params_t = infmt::details::types<
       infmt::details::format_param<std::uint8_t, 0, 0, 3, 9u>,
@@ -405,7 +444,7 @@ int main()
     constexpr auto s = INFMT_STRING(
       " {uint8_t} {int8_t} {uint16_t} {int16_t} {uint32_t} {int32_t} "
       "{uint64_t} {int64_t} {str123} ");
-    constexpr auto result = infmt::details::collect_format_info<0u>(s);
+    constexpr auto result = infmt::details::collect_format_info(s);
     using result_t = std::remove_cv_t<decltype(result)>;
     using expected_t = infmt::details::types<
       infmt::details::format_param<std::uint8_t, 1u, 1, 3, 9u>,
@@ -497,6 +536,953 @@ int main()
     assert(cv == "|42..****************|");
     std::cout << "'" << cv << "'\n";
   }
+  {
+    assert(infmt::details::count_digits(0u) == 1u);
+    for (auto i = 1u; i < 20u; ++i) {
+      const auto power = infmt::details::powers_of_10[i];
+      assert(infmt::details::count_digits(power - 1u) == i);
+      assert(infmt::details::count_digits(power) == i + 1u);
+    }
+    assert(infmt::details::count_digits(
+             std::numeric_limits<std::uint64_t>::max()) == 20u);
+  }
+  {
+    const auto write_integer_tester = [](auto val, std::string_view expected) {
+      char buf[32];
+      const auto end = infmt::details::write_integer(buf, val);
+      assert((std::string_view{ buf, std::size_t(end - buf) } == expected));
+    };
+
+    write_integer_tester(std::uint8_t{ 0 }, "0");
+    write_integer_tester(std::uint8_t{ 255 }, "255");
+    write_integer_tester(std::int8_t{ -128 }, "-128");
+    write_integer_tester(std::int16_t{ -32768 }, "-32768");
+    write_integer_tester(std::uint16_t{ 65535 }, "65535");
+    write_integer_tester(std::int32_t{ -7 }, "-7");
+    write_integer_tester(std::uint32_t{ 4294967295u }, "4294967295");
+    write_integer_tester(std::uint64_t{ 100000000u }, "100000000");
+    write_integer_tester(std::uint64_t{ 4294967296u }, "4294967296");
+    write_integer_tester(std::numeric_limits<std::int64_t>::min(),
+                         "-9223372036854775808");
+    write_integer_tester(std::numeric_limits<std::uint64_t>::max(),
+                         "18446744073709551615");
+  }
+  {
+    auto formatter = infmt::make_formatter(INFMT_STRING("|{int16_t}|"));
+    formatter.set<0>(-12345);
+    formatter.set_with_fill<0>(-1, '_');
+    const auto cv = formatter.to_string_view();
+    assert(cv == "|-1____|");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    // Values are converted to the type of the param, like in an assignment
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("|{uint8_t:>}|{uint64_t}|{int8_t:>}|"));
+    formatter.set_all(300, -1, 200u);
+    const auto cv = formatter.to_string_view();
+    assert(cv == "| 44|18446744073709551615| -56|");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("|{uint32_t:>}|{int16_t:0>}|{uint8_t:*<}|"));
+    const auto cv = formatter.to_string_view();
+    assert(cv == "|          |000000|***|");
+
+    formatter.set<0>(1234567u);
+    formatter.set<1>(-42);
+    formatter.set<2>(7);
+    assert(cv == "|   1234567|-00042|7**|");
+
+    formatter.set<0>(5u);
+    formatter.set<1>(-32768);
+    formatter.set<2>(255);
+    assert(cv == "|         5|-32768|255|");
+
+    formatter.set_with_fill<0>(12u, '.');
+    assert(cv == "|........12|-32768|255|");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    auto formatter =
+      infmt::make_formatter(INFMT_STRING("|{str6:>}|{str4:_<}|{str3}|"));
+    const auto cv = formatter.to_string_view();
+
+    formatter.set<0>(std::string_view{ "abc" });
+    formatter.set<1>(std::string_view{ "xy" });
+    const auto end = formatter.set<2>(std::string_view{ "too long" });
+    assert(cv == "|   abc|xy__|too|");
+    assert(*end == '|');
+
+    formatter.set<0>(std::string_view{ "z" });
+    formatter.set<1>(std::string_view{ "q" });
+    assert(cv == "|     z|q___|too|");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("|{uint64_t}|{str8}|{int8_t:>}|"), infmt::track_written);
+    const auto cv = formatter.to_string_view();
+
+    formatter.set<0>(123456u);
+    formatter.set<1>(std::string_view{ "abcdefgh" });
+    formatter.set<2>(-5);
+    assert(cv == "|123456              |abcdefgh|  -5|");
+
+    formatter.set<0>(42u);
+    formatter.set<1>(std::string_view{ "xyz" });
+    formatter.set<2>(7);
+    assert(cv == "|42                  |xyz     |   7|");
+
+    formatter.set<0>(9999u);
+    formatter.set_with_fill_hint<0>(1, '.', nullptr);
+    assert(cv == "|1...                |xyz     |   7|");
+
+    formatter.set_with_fill<0>(55, '*');
+    formatter.set<0>(3u);
+    assert(cv == "|3 ******************|xyz     |   7|");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("{uint64_t:>}|{str5}|{int8_t}|{uint16_t:0>}"),
+      infmt::track_written);
+    const auto cv = formatter.to_string_view();
+
+    formatter.set_all(12345u, "hello", -128, 7);
+    assert(cv == "               12345|hello|-128|00007");
+
+    formatter.set_all(1u, std::string{ "hi" }, 3, 65535);
+    assert(cv == "                   1|hi   |3   |65535");
+
+    formatter.set_some<3, 1>(42, std::string_view{ "abc" });
+    assert(cv == "                   1|abc  |3   |00042");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    constexpr auto segments =
+      infmt::details::make_segments<12u, infmt::details::format_param<
+                                           std::uint8_t, 1u, 1u, 3u, 9u>,
+                                    infmt::details::format_param<
+                                      std::uint8_t, 10u, 4u, 3u, 9u>>();
+    static_assert(segments.size() == 4u);
+    static_assert(segments[0].offset == 0u && segments[0].length == 1u &&
+                  segments[0].param == infmt::details::plain_segment);
+    static_assert(segments[1].offset == 1u && segments[1].length == 3u &&
+                  segments[1].param == 0u);
+    static_assert(segments[2].offset == 4u && segments[2].length == 3u &&
+                  segments[2].param == 1u);
+    static_assert(segments[3].offset == 7u && segments[3].length == 5u &&
+                  segments[3].param == infmt::details::plain_segment);
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("<a>{str10}</a><b>{uint32_t}{int8_t:>}</b>"),
+      infmt::track_written);
+    formatter.set<0>(std::string_view{ "xyz" });
+    formatter.set<1>(42u);
+    formatter.set<2>(-1);
+
+    const auto segments = formatter.segments();
+    static_assert(segments.size() == 6u);
+
+    std::string joined;
+    for (const auto segment : segments) {
+      joined.append(segment);
+    }
+    assert(joined == "<a>xyz</a><b>42  -1</b>");
+
+#ifdef INFMT_HAS_IOVEC
+    const auto iov = formatter.to_iovec();
+    auto total = 0u;
+    for (const auto& v : iov) {
+      total += v.iov_len;
+    }
+    assert(total == joined.size());
+#endif
+
+    auto untracked =
+      infmt::make_formatter(INFMT_STRING("<a>{str4}</a>{uint8_t}"));
+    untracked.set<0>(std::string_view{ "x" });
+    const auto untracked_segments = untracked.segments();
+    static_assert(untracked_segments.size() == 4u);
+    assert(untracked_segments[1] == "x   ");
+    std::cout << "'" << joined << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("{{\"id\":{uint64_t},\"name\":\"{str16}\"}}"),
+      infmt::track_written);
+    formatter.set_all(7u, "alice");
+
+    char out[64];
+    auto end = formatter.copy_to(out);
+    assert((std::string_view{ out, std::size_t(end - out) } ==
+            R"({"id":7,"name":"alice"})"));
+    assert(formatter.compact_size() == std::size_t(end - out));
+
+    formatter.set_all(1234567890u, "bob");
+    end = formatter.copy_to(out);
+    assert((std::string_view{ out, std::size_t(end - out) } ==
+            R"({"id":1234567890,"name":"bob"})"));
+    assert(formatter.compact_size() == std::size_t(end - out));
+    std::cout << "'" << std::string_view{ out, std::size_t(end - out) }
+              << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("|{double}|{double:.2}|{float:>}|{double:0>.3}|"));
+    const auto cv = formatter.to_string_view();
+
+    formatter.set_all(0.1, 2.5, 1.5f, -3.25);
+    assert(cv == "|0.1                     |2.50                    |"
+                 "            1.5|-0000000000000000003.250|");
+
+    // 1e300 doesn't fit in fixed notation
+    formatter.set_all(-2.2250738585072014e-308, 1e300, -0.0f, 1e19);
+    assert(cv == "|-2.2250738585072014e-308|1e+300                  |"
+                 "             -0|10000000000000000000.000|");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("|{bool}|{bool:>}|{bool:*<7}|{char}|{unsigned char:0>}|"
+                   "{short}|{unsigned}|{long long}|{unsigned long}|"),
+      infmt::track_written);
+    const auto cv = formatter.to_string_view();
+
+    formatter.set_all(false, false, false, 'A', 7, -300, 4000000000u,
+                      std::numeric_limits<long long>::min(), 0ul);
+    assert(cv == "|false|false|false**|65  |007|-300  |4000000000|"
+                 "-9223372036854775808|0                   |");
+
+    formatter.set_all(true, true, true, -128, 255, 1, 1u, 1, 2ul);
+    assert(cv == "|true | true|true***|-128|255|1     |1         |"
+                 "1                   |2                   |");
+
+    formatter.set_with_fill<1>(false, '.');
+    formatter.set_with_fill<2>(true, '.');
+    assert(cv.substr(0u, 21u) == "|true |false|true...|");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    // More segments than are copied unrolled
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("{uint8_t},{uint8_t},{uint8_t},{uint8_t},{uint8_t},"
+                   "{uint8_t},{uint8_t},{uint8_t},{uint8_t},{uint8_t},"
+                   "{uint8_t},{uint8_t},{uint8_t},{uint8_t},{uint8_t},"
+                   "{uint8_t},{uint8_t},{uint8_t},{uint8_t},{uint8_t},"
+                   "{uint8_t},{uint8_t},{uint8_t},{uint8_t},{uint8_t},"
+                   "{uint8_t},{uint8_t},{uint8_t},{uint8_t},{uint8_t},"
+                   "{uint8_t},{uint8_t},{uint8_t},{uint8_t},{str4:>}."),
+      infmt::track_written);
+    static_assert(std::tuple_size_v<decltype(formatter.segments())> > 64u);
+
+    formatter.set<0>(1);
+    formatter.set<17>(200);
+    formatter.set<34>(std::string_view{ "ab" });
+
+    char out[sizeof(formatter)];
+    const auto end = formatter.copy_to(out);
+    const auto compact = std::string_view{ out, std::size_t(end - out) };
+    assert(compact == "1,,,,,,,,,,,,,,,,,200,,,,,,,,,,,,,,,,,  ab.");
+    assert(formatter.compact_size() == compact.size());
+    assert(formatter.segments()[34] == "200");
+    std::cout << "'" << compact << "'\n";
+  }
+  {
+    auto pool = infmt::make_formatter_pool<3>(
+      INFMT_STRING("seq={uint32_t} {str4}"), infmt::track_written);
+    static_assert(pool.size() == 3u);
+
+    const auto first = pool.acquire();
+    const auto second = pool.acquire();
+    const auto third = pool.acquire();
+    assert(first == 0u && second == 1u && third == 2u);
+    assert(pool.acquire() == pool.npos);
+    assert(pool.in_flight_count() == 3u);
+
+    pool[first].set_all(1u, "a");
+    pool[second].set_all(22u, "bb");
+    pool[third].set_all(333u, "ccc");
+    assert(pool[first].to_string_view() == "seq=1          a   ");
+    assert(pool[second].to_string_view() == "seq=22         bb  ");
+
+    // Completions may come out of order
+    pool.release(second);
+    assert(!pool.in_flight(second) && pool.in_flight(first));
+    assert(pool.acquire() == second);
+    pool.release(first);
+    pool.release(third);
+    assert(pool.acquire() == third);
+    assert(pool.acquire() == first);
+
+    // Released slots keep their content
+    pool[first].set<0>(4u);
+    assert(pool[first].to_string_view() == "seq=4          a   ");
+    std::cout << "'" << pool[third].to_string_view() << "'\n";
+  }
+  {
+    auto status = infmt::make_seqlock_formatter(
+      INFMT_STRING("up={bool:>} conns={uint16_t}"), infmt::track_written);
+    static_assert(decltype(status)::size() == 20u);
+
+    char out[decltype(status)::size()];
+    auto end = status.read(out);
+    assert((std::string_view{ out, std::size_t(end - out) } ==
+            "up=      conns=     "));
+
+    status.update([](auto& f) { f.set_all(true, 12); });
+    status.set<1>(3);
+    end = status.read(out);
+    assert((std::string_view{ out, std::size_t(end - out) } ==
+            "up= true conns=3    "));
+    std::cout << "'" << std::string_view{ out, std::size_t(end - out) }
+              << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("seq={uint32_t} px={double:>} user={str8}"),
+      infmt::track_dirty);
+    static_assert(formatter.slot_range(1u).offset == 18u);
+    static_assert(formatter.slot_range(1u).length == 24u);
+    assert(formatter.take_dirty().none());
+
+    formatter.set<0>(7u);
+    formatter.set<2>(std::string_view{ "bob" });
+    assert(formatter.take_dirty().to_ulong() == 0b101u);
+    assert(formatter.take_dirty().none());
+
+    formatter.set<0>(8u);
+    std::string shipped;
+    formatter.take_dirty_ranges([&](unsigned offset, std::string_view bytes) {
+      shipped += std::to_string(offset) + ":" + std::string{ bytes };
+    });
+    assert(shipped == "4:8         ");
+    std::cout << "'" << shipped << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("n={uint16_t} p={double:.2} s={str4:_<} j={jstr6:*>}"),
+      infmt::track_written, infmt::collect_stats);
+
+    formatter.set<0>(1234u);
+    formatter.set<0>(7u);
+    formatter.set<1>(1.5);
+    formatter.set<1>(1e300);
+    formatter.set<2>(std::string_view{ "abcdef" });
+    formatter.set<2>(std::string_view{ "x" });
+    formatter.set<3>(std::string_view{ "a\"b" });
+    formatter.set<3>(std::string_view{ "abcdefg" });
+
+    const auto check = [&](unsigned n, std::uint64_t writes,
+                           std::uint64_t overflows, std::uint64_t written,
+                           std::uint64_t filled) {
+      const auto& stats = formatter.stats()[n];
+      return stats.writes == writes && stats.overflows == overflows &&
+             stats.bytes_written == written && stats.bytes_filled == filled;
+    };
+    assert(check(0u, 2u, 0u, 5u, 3u));
+    assert(check(1u, 2u, 1u, 10u, 0u));
+    assert(check(2u, 2u, 1u, 5u, 3u));
+    assert(check(3u, 2u, 1u, 10u, 2u));
+
+    formatter.set_with_fill<0>(5u, '.');
+    assert(check(0u, 3u, 0u, 6u, 7u));
+
+    formatter.reset_stats();
+    assert(check(0u, 0u, 0u, 0u, 0u));
+    std::cout << "'" << formatter.to_string_view() << "'\n";
+  }
+  {
+    // The minus and the zero before the point of a zero filled value count
+    // as written
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("{int32_t:0>}|{int32_t:>}|{dec64.2:0>}"),
+      infmt::collect_stats);
+    formatter.set_all(-42, -2147483647 - 1, -5);
+    assert(formatter.to_string_view() ==
+           "-0000000042|-2147483648|-00000000000000000.05");
+
+    const auto& stats = formatter.stats();
+    assert(stats[0].bytes_written == 3u && stats[0].bytes_filled == 8u);
+    assert(stats[1].bytes_written == 11u && stats[1].bytes_filled == 0u);
+    assert(stats[2].bytes_written == 5u && stats[2].bytes_filled == 16u);
+    std::cout << "'" << formatter.to_string_view() << "'\n";
+  }
+  {
+    constexpr auto format_str = INFMT_STRING("id={uint16_t} name={str6:>}");
+    using view_t = infmt::formatter_view<decltype(format_str)>;
+    static_assert(view_t::size() == 20u);
+
+    char memory[32];
+    auto view = infmt::make_formatter_view(format_str, memory,
+                                           infmt::track_written);
+    assert((std::string_view{ memory, view_t::size() } ==
+            "id=      name=      "));
+
+    view.set<0>(42u);
+    view.set<1>(std::string_view{ "ann" });
+    assert((std::string_view{ memory, view_t::size() } ==
+            "id=42    name=   ann"));
+    assert(view.to_string_view().data() == memory);
+
+    std::array<char, 20u> exact;
+    auto exact_view = infmt::make_formatter_view(format_str, exact);
+    exact_view.set<0>(65535u);
+    assert((std::string_view{ exact.data(), exact.size() } ==
+            "id=65535 name=      "));
+
+    // A view owns its state of the memory, so it can be moved, not copied
+    static_assert(!std::is_default_constructible_v<view_t>);
+    static_assert(!std::is_copy_constructible_v<view_t>);
+    static_assert(!std::is_copy_assignable_v<view_t>);
+    static_assert(std::is_nothrow_move_constructible_v<view_t>);
+    auto from_pointer = infmt::make_formatter_view(format_str, &memory[0]);
+    auto moved = std::move(from_pointer);
+    moved.set<1>(std::string_view{ "joanna" });
+    assert(moved.to_string_view().data() == memory);
+    assert(moved.to_string_view() == "id=      name=joanna");
+    std::cout << "'" << moved.to_string_view() << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING(R"({{"a":"{jstr40}","b":"{jstr6:>}","c":"{jstr7:_<}"}})"),
+      infmt::track_written);
+
+    formatter.set<0>(std::string_view{ "say \"hi\"\\\n\x01" });
+    assert(formatter.segments()[1] == R"(say \"hi\"\\\n\u0001)");
+
+    // Escapes are never cut
+    auto end = formatter.set<1>(std::string_view{ "abcde\"" });
+    assert(formatter.segments()[3] == " abcde");
+    assert(end == formatter.segments()[3].data() + 6);
+    formatter.set<2>(std::string_view{ "abcdef\t" });
+    assert(formatter.segments()[5] == "abcdef_");
+
+    // Neither are UTF-8 code points
+    formatter.set<2>(std::string_view{ "abcde\xc5\xbc" });
+    assert(formatter.segments()[5] == "abcde\xc5\xbc");
+    formatter.set<2>(std::string_view{ "abcdef\xc5\xbc" });
+    assert(formatter.segments()[5] == "abcdef_");
+
+    // Long plain runs go through the vectorized scan
+    const std::string long_value =
+      std::string(35u, 'x') + "\"" + std::string(10u, 'y');
+    formatter.set<0>(std::string_view{ long_value });
+    assert(formatter.segments()[1] == std::string(35u, 'x') + "\\\"yyy");
+    formatter.set_all("", "", "");
+    assert(formatter.segments()[1].empty());
+    std::cout << "'" << formatter.to_string_view() << "'\n";
+  }
+  {
+    // The vectorized scan finds the first char to escape at any position,
+    // also across 16 and 32 char blocks. Chars from 0x7f up need no escape.
+    for (const auto special : { '"', '\\', '\x00', '\x1f' }) {
+      for (auto size = 0u; size <= 100u; ++size) {
+        for (auto pos = 0u; pos <= size; ++pos) {
+          std::string value(size, 'a');
+          for (auto i = 0u; i < size; i += 3u) {
+            value[i] = static_cast<char>(0x7fu + i % 0x80u);
+          }
+          if (pos < size) {
+            value[pos] = special;
+          }
+          assert(infmt::details::json_plain_prefix(
+                   value.data(), value.data() + value.size()) == pos);
+        }
+      }
+    }
+  }
+  {
+    static_assert(infmt::details::max_chars_in_type<std::int8_t>(2u) == 9u);
+    static_assert(infmt::details::max_chars_in_type<std::uint64_t>(16u) ==
+                  16u);
+
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("|{uint64_t:x}|{uint32_t:X}|{uint64_t:o}|{uint8_t:b}|"
+                   "{uint64_t:0>x}|{int16_t:>x}|{int8_t:0>b}|{uint16_t:d}|"),
+      infmt::track_written);
+    const auto segments = formatter.segments();
+    static_assert(std::tuple_size_v<decltype(segments)> == 17u);
+
+    formatter.set_all(0xdeadbeefcafe, 0xabcdefu, 01777777777777777777777u,
+                      5u, 0x1234u, -0x7fff, -128, 65535u);
+    assert(formatter.segments()[1] == "deadbeefcafe");
+    assert(formatter.segments()[3] == "ABCDEF");
+    assert(formatter.segments()[5] == "1777777777777777777777");
+    assert(formatter.segments()[7] == "101");
+    assert(formatter.segments()[9] == "0000000000001234");
+    assert(formatter.segments()[11] == "-7fff");
+    assert(formatter.segments()[13] == "-10000000");
+    assert(formatter.segments()[15] == "65535");
+
+    formatter.set_all(0u, 0u, 0u, 0u, ~std::uint64_t{ 0u }, 0, 1, 0u);
+    assert(formatter.segments()[1] == "0");
+    assert(formatter.segments()[9] == "ffffffffffffffff");
+    assert(formatter.segments()[13] == "000000001");
+    std::cout << "'" << formatter.to_string_view() << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("{timestamp_ns} [{str4}] {timestamp_ns}"),
+      infmt::track_written);
+    const auto cv = formatter.to_string_view();
+    static_assert(formatter.size() == 68u);
+
+    // 2024-02-29T23:59:58.123456789Z
+    constexpr std::int64_t leap_day = 1709251198123456789;
+    formatter.set_all(leap_day, "INFO", 0);
+    assert(cv == "2024-02-29T23:59:58.123456789Z [INFO] "
+                 "1970-01-01T00:00:00.000000000Z");
+
+    // Same minute, then next minute and day
+    formatter.set<0>(leap_day + 1'000'000'000);
+    assert(cv.substr(0u, 30u) == "2024-02-29T23:59:59.123456789Z");
+    formatter.set<0>(leap_day + 2'000'000'000);
+    assert(cv.substr(0u, 30u) == "2024-03-01T00:00:00.123456789Z");
+    formatter.set<0>(leap_day);
+    assert(cv.substr(0u, 30u) == "2024-02-29T23:59:58.123456789Z");
+
+    // Before the epoch
+    formatter.set<2>(-1);
+    assert(cv.substr(38u) == "1969-12-31T23:59:59.999999999Z");
+    formatter.set<2>(std::chrono::system_clock::time_point{
+      std::chrono::hours{ 24 * 365 } });
+    assert(cv.substr(38u) == "1971-01-01T00:00:00.000000000Z");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    // The first value writes the whole timestamp, also in the first minute
+    // of the range
+    auto formatter = infmt::make_formatter(INFMT_STRING("{timestamp_ns}"));
+    formatter.set<0>(std::numeric_limits<std::int64_t>::min() +
+                     1'000'000'000);
+    assert(formatter.to_string_view() == "1677-09-21T00:12:44.145224192Z");
+
+    auto runtime = *infmt::make_runtime_formatter("{timestamp_ns}");
+    runtime.set(0u, std::chrono::system_clock::time_point{
+                      std::chrono::nanoseconds{
+                        std::numeric_limits<std::int64_t>::min() +
+                        1'000'000'000 } });
+    assert(runtime.to_string_view() == formatter.to_string_view());
+
+    // Timestamps always fill their 30 chars. `{timestamp_ns:>34}` doesn't
+    // compile and runtime formatters reject it.
+    assert(!infmt::make_runtime_formatter("{timestamp_ns:>34}"));
+    assert(!infmt::make_runtime_formatter("{timestamp_ns:*<}"));
+    assert(!infmt::make_runtime_formatter("{timestamp_ns:34}"));
+    std::cout << "'" << formatter.to_string_view() << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("|{dec64.4}|{dec64.2:>}|{dec64}|{dec64.19}|{dec64.3:0>}|"),
+      infmt::track_written);
+    static_assert(formatter.slot_range(0u).length == 21u);
+    static_assert(formatter.slot_range(2u).length == 20u);
+    static_assert(formatter.slot_range(3u).length == 22u);
+
+    formatter.set_all(1234567, -5, -42, 1, -12345);
+    assert(formatter.segments()[1] == "123.4567");
+    assert(formatter.segments()[3] == "                -0.05");
+    assert(formatter.segments()[5] == "-42");
+    assert(formatter.segments()[7] == "0.0000000000000000001");
+    assert(formatter.segments()[9] == "-0000000000000012.345");
+
+    constexpr auto min = std::numeric_limits<std::int64_t>::min();
+    formatter.set_all(min, min, min, min, 0);
+    assert(formatter.segments()[1] == "-922337203685477.5808");
+    assert(formatter.segments()[3] == "-92233720368547758.08");
+    assert(formatter.segments()[5] == "-9223372036854775808");
+    assert(formatter.segments()[7] == "-0.9223372036854775808");
+    assert(formatter.segments()[9] == "00000000000000000.000");
+    std::cout << "'" << formatter.to_string_view() << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("{seq_no:uint64_t}|{uint8_t}|{price:dec64.2:>}|"
+                   "{user:str5}|{uint16_t:x}"));
+    using formatter_t = decltype(formatter);
+    const auto cv = formatter.to_string_view();
+    static_assert(formatter_t::index_of("seq_no") == 0u);
+    static_assert(formatter_t::index_of("price") == 2u);
+    static_assert(formatter_t::index_of("user") == 3u);
+    static_assert(formatter_t::index_of("uint8_t") == formatter_t::npos);
+    static_assert(formatter_t::index_of("missing") == formatter_t::npos);
+    // `uint16_t` is a type, so the param is unnamed and `x` is its spec
+    static_assert(formatter_t::index_of("uint16_t") == formatter_t::npos);
+    static_assert(infmt::details::calc_size("{price:dec64.2:>}") == 21u);
+
+    formatter.set(INFMT_STRING("seq_no"), 42u);
+    formatter.set(INFMT_STRING("price"), 12345);
+    formatter.set(INFMT_STRING("user"), "bob");
+    formatter.set<formatter_t::index_of("seq_no")>(43u);
+    formatter.set<1>(7);
+    assert(cv.substr(0u, 53u) ==
+           "43                  |7  |               123.45|bob  |");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    // Names that start like a type are names, not widths or scales
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("{strike:uint32_t}|{jstream:str4}|{dec64x:uint8_t}|"));
+    using formatter_t = decltype(formatter);
+    static_assert(formatter_t::size() == 20u);
+    static_assert(formatter_t::index_of("strike") == 0u);
+    static_assert(formatter_t::index_of("jstream") == 1u);
+    static_assert(formatter_t::index_of("dec64x") == 2u);
+
+    formatter.set(INFMT_STRING("strike"), 4100u);
+    formatter.set(INFMT_STRING("jstream"), "a\"b");
+    formatter.set(INFMT_STRING("dec64x"), 7u);
+    assert(formatter.to_string_view() == "4100      |a\"b |7  |");
+    std::cout << "'" << formatter.to_string_view() << "'\n";
+  }
+  {
+    // Derived kinds without a range after the colon are names
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("a={len:uint32_t}|{fixsum:uint8_t}|"));
+    using formatter_t = decltype(formatter);
+    static_assert(formatter_t::size() == 17u);
+    static_assert(formatter_t::index_of("len") == 0u);
+    static_assert(formatter_t::index_of("fixsum") == 1u);
+
+    formatter.set<0>(5u);
+    formatter.set(INFMT_STRING("fixsum"), 7u);
+    assert(formatter.to_string_view() == "a=5         |7  |");
+    std::cout << "'" << formatter.to_string_view() << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("{uint32_t:>}|{uint16_t:0>}|{uint64_t}|{uint8_t:>}|"
+                   "{uint16_t:<}|"),
+      infmt::track_written);
+    const auto cv = formatter.to_string_view();
+
+    formatter.set_all(99u, 9u, 9u, 254u, 9u);
+    formatter.increment<0>();
+    formatter.add<1>(991u);
+    formatter.increment<2>();
+    formatter.increment<3>();
+    formatter.increment<4>();
+    assert(cv == "       100|01000|10                  |255|10   |");
+    assert(formatter.written_length<2>() == 2u);
+
+    // Past the maximum of the type, the value wraps around
+    formatter.increment<3>();
+    formatter.add<1>(64536u);
+    formatter.add<2>(18446744073709551615u);
+    assert(cv == "       100|00000|9                   |  0|10   |");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(INFMT_STRING("n={uint32_t}|"));
+    const auto cv = formatter.to_string_view();
+
+    formatter.increment<0>();
+    assert(cv.substr(0u, 4u) == "n=1 ");
+    formatter.add<0>(1233u);
+    assert(cv.substr(0u, 7u) == "n=1234 ");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    // FIX body length: from the mark after `9=...|` to the checksum
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("8=FIX.4.2|9={len:body..trailer}|{body:mark}35=D|"
+                   "49={str8}|11={uint64_t}|{trailer:mark}10=000|"),
+      infmt::track_written);
+    using formatter_t = decltype(formatter);
+    char out[formatter_t::size()];
+    const auto compact = [&] {
+      return std::string_view{ out, static_cast<std::size_t>(
+                                      formatter.copy_to(out) - out) };
+    };
+
+    assert(compact() == "8=FIX.4.2|9=13|35=D|49=|11=|10=000|");
+    // `set<0>` and `set<1>` don't compile, with numbers or strings alike:
+    // length params and marks can't be set.
+    formatter.set_all("SENDER", 12345u);
+    assert(compact() == "8=FIX.4.2|9=24|35=D|49=SENDER|11=12345|10=000|");
+    formatter.set<2>(std::string_view{ "AB" });
+    formatter.set<3>(7u);
+    assert(compact() == "8=FIX.4.2|9=16|35=D|49=AB|11=7|10=000|");
+    std::cout << "'" << compact() << "'\n";
+  }
+  {
+    // Without `track_written`, the length counts whole slots, so it's known
+    // at compile time.
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("Content-Length: {len:1..:>}\r\n\r\n{str4}{uint8_t:>}"));
+    const auto cv = formatter.to_string_view();
+
+    assert(cv == "Content-Length:          7\r\n\r\n       ");
+    formatter.set_all("ok", 200u);
+    assert(cv == "Content-Length:          7\r\n\r\nok  200");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("8=FIX.4.2|9={len:body..trailer}|{body:mark}35=D|"
+                   "49={str8}|11={uint64_t}|{trailer:mark}"
+                   "10={fixsum:..trailer}|"),
+      infmt::track_written);
+    char out[decltype(formatter)::size()];
+    const auto check = [&] {
+      const auto end = formatter.copy_to(out);
+      const auto trailer = std::string_view{ out, static_cast<std::size_t>(
+                                                   end - out) }
+                             .find("10=");
+      auto sum = 0u;
+      for (auto i = 0u; i < trailer; ++i) {
+        sum += static_cast<unsigned char>(out[i]);
+      }
+      const auto expected = std::to_string(1000u + sum % 256u).substr(1u);
+      assert(std::string_view(out + trailer + 3u, 3u) == expected);
+      return std::string_view{ out, static_cast<std::size_t>(end - out) };
+    };
+
+    check();
+    formatter.set_all("SENDER", 12345u);
+    check();
+    formatter.set<2>(std::string_view{ "AB" });
+    formatter.increment<3>();
+    std::cout << "'" << check() << "'\n";
+  }
+  {
+    // CRC-32C of "123456789" is e3069283
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("{crc32c:1..}|{str9}"), infmt::track_written);
+    const auto cv = formatter.to_string_view();
+
+    assert(cv.substr(0u, 9u) == "00000000|");
+    formatter.set<1>(std::string_view{ "123456789" });
+    assert(cv == "e3069283|123456789");
+    formatter.set<1>(std::string_view{ "12" });
+    formatter.set<1>(std::string_view{ "123456789" });
+    assert(cv == "e3069283|123456789");
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    // The CRC covers the FIX checksum, which is updated first
+    auto formatter = infmt::make_formatter(
+      INFMT_STRING("{crc32c:1..:X}|{uint16_t:>}|{fixsum:1..2}"));
+    const auto cv = formatter.to_string_view();
+    const auto crc = [&] {
+      auto crc = ~std::uint32_t{};
+      for (const auto c : cv.substr(9u)) {
+        crc ^= static_cast<unsigned char>(c);
+        for (auto bit = 0u; bit < 8u; ++bit) {
+          crc = (crc >> 1u) ^ (0x82F63B78u & (0u - (crc & 1u)));
+        }
+      }
+      char hex[9];
+      std::snprintf(hex, sizeof(hex), "%08X", ~crc);
+      return std::string{ hex };
+    };
+
+    assert(cv.substr(9u) == "     |028" && cv.substr(0u, 8u) == crc());
+    formatter.set_all(42u);
+    assert(cv.substr(9u) == "   42|066" && cv.substr(0u, 8u) == crc());
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    // Without track_written CRCs are patched with the change of every slot,
+    // also of a CRC in the range of another one
+    auto formatter = infmt::make_formatter(INFMT_STRING(
+      "{crc32c:1..}|{str6:<}|{uint32_t:>}|{crc32c:4..}|{uint16_t:0>}|"
+      "{dec64.2:>}|"));
+    using formatter_t = decltype(formatter);
+    const auto cv = formatter.to_string_view();
+    const auto crc_from = [&](unsigned n) {
+      auto crc = ~std::uint32_t{};
+      for (const auto c : cv.substr(formatter_t::slot_range(n).offset)) {
+        crc ^= static_cast<unsigned char>(c);
+        for (auto bit = 0u; bit < 8u; ++bit) {
+          crc = (crc >> 1u) ^ (0x82F63B78u & (0u - (crc & 1u)));
+        }
+      }
+      char hex[9];
+      std::snprintf(hex, sizeof(hex), "%08x", ~crc);
+      return std::string{ hex };
+    };
+    const auto check = [&] {
+      return cv.substr(0u, 8u) == crc_from(1u) &&
+             cv.substr(formatter_t::slot_range(3u).offset, 8u) ==
+               crc_from(4u);
+    };
+
+    assert(check());
+    const char* names[] = { "", "ann", "joanna", "bob" };
+    for (auto i = 0u; i < 200u; ++i) {
+      switch (i % 4u) {
+        case 0u:
+          formatter.set<1>(std::string_view{ names[i % 3u + (i & 1u)] });
+          break;
+        case 1u:
+          formatter.set<2>(i * 2654435761u);
+          break;
+        case 2u:
+          formatter.set_some<4, 5>(i * 331u, static_cast<int>(i) - 100);
+          break;
+        default:
+          formatter.increment<4>();
+          formatter.add<2>(7u);
+          break;
+      }
+      assert(check());
+    }
+    std::cout << "'" << cv << "'\n";
+  }
+  {
+    // The SSE4.2 path, when compiled with it, goes 8 chars at a time. Every
+    // length and alignment gives the CRC of the table.
+    std::array<char, 80u> data;
+    for (auto i = 0u; i < data.size(); ++i) {
+      data[i] = static_cast<char>(i * 37u + 11u);
+    }
+    for (auto begin = 0u; begin < 8u; ++begin) {
+      for (auto size = 0u; begin + size <= data.size(); ++size) {
+        assert(infmt::details::crc32c_update(~0u, &data[begin], size) ==
+               infmt::details::crc32c_update_table(~0u, &data[begin], size));
+      }
+    }
+  }
+  {
+    // Every row is what a new formatter makes of its values
+    constexpr auto format_str = INFMT_STRING(
+      "{crc32c:1..}|{uint32_t}|{int16_t:0>}|{dec64.2:>}|{timestamp_ns}|"
+      "{str6:<}|{jstr8:*>}|{bool}|{fixsum:1..8}|");
+    using formatter_t = decltype(infmt::make_formatter(format_str));
+    constexpr auto rows = 1000u;
+    std::vector<std::uint64_t> ids(rows);
+    std::vector<int> qtys(rows);
+    std::vector<std::int64_t> prices(rows);
+    std::vector<std::int64_t> times(rows);
+    std::vector<std::string> names(rows);
+    std::vector<std::string_view> notes(rows);
+    std::vector<bool> flags(rows);
+    for (auto i = 0u; i < rows; ++i) {
+      ids[i] = i * 7919u;
+      qtys[i] = static_cast<int>(i % 200u) - 100;
+      prices[i] = static_cast<std::int64_t>(i) * 101 - 5000;
+      times[i] = 1'700'000'000'000'000'000 + std::int64_t{ i } * 1'000'000'007;
+      names[i] = std::string(i % 9u, static_cast<char>('a' + i % 26u));
+      notes[i] = i % 3u == 0u ? "\"q\"" : "note";
+      flags[i] = i % 2u == 0u;
+    }
+
+    std::vector<char> arena(rows * formatter_t::size());
+    // Two threads would split rows like this
+    const auto split = rows / 3u;
+    formatter_t::format_rows(arena.data(), 0u, split, ids.data(), qtys,
+                             prices.data(), times, names, notes, flags);
+    formatter_t::format_rows(arena.data(), split, rows, ids.data(), qtys,
+                             prices.data(), times, names, notes, flags);
+
+    for (auto i = 0u; i < rows; ++i) {
+      auto formatter = infmt::make_formatter(format_str);
+      formatter.set_all(ids[i], qtys[i], prices[i], times[i], names[i],
+                        notes[i], static_cast<bool>(flags[i]));
+      const auto row = std::string_view{
+        &arena[i * formatter_t::size()], formatter_t::size()
+      };
+      assert(row == formatter.to_string_view());
+    }
+    std::cout << "'" << std::string_view(arena.data(), formatter_t::size())
+              << "'\n";
+  }
+  {
+    // Same output as a compile time formatter of the same format
+    constexpr auto format_str = INFMT_STRING(
+      "{{{seq_no:uint64_t}|{int32_t:>}|{double:.2}|{uint16_t:0>X}|"
+      "{dec64.3}|{bool:<}|{timestamp_ns}|{name:jstr12}|{str4:*>}}}");
+    auto compiled = infmt::make_formatter(format_str, infmt::track_written);
+    auto formatter =
+      *infmt::make_runtime_formatter(format_str.to_string_view());
+    const auto cv = formatter.to_string_view();
+    assert(cv == compiled.to_string_view());
+    assert(formatter.params_count() == 9u);
+    assert(formatter.index_of("name") == 7u);
+    assert(formatter.index_of("missing") == infmt::runtime_formatter::npos);
+
+    const auto check = [&] {
+      char out[decltype(compiled)::size()];
+      char compiled_out[decltype(compiled)::size()];
+      const auto end = formatter.copy_to(out);
+      const auto compiled_end = compiled.copy_to(compiled_out);
+      assert(cv == compiled.to_string_view());
+      assert(std::string_view(out, end - out) ==
+             std::string_view(compiled_out, compiled_end - compiled_out));
+      assert(formatter.compact_size() == compiled.compact_size());
+    };
+
+    const auto time = std::chrono::system_clock::time_point{} +
+                      std::chrono::nanoseconds{ 86'400'123'456'789 };
+    formatter.set(0u, 1234567u);
+    formatter.set(1u, -42);
+    formatter.set(2u, 3.14159);
+    formatter.set(3u, 0xbeef);
+    formatter.set(4u, -12345);
+    formatter.set(5u, true);
+    formatter.set(6u, time);
+    formatter.set(7u, "a\"b");
+    formatter.set(8u, "abcdef");
+    compiled.set_all(1234567u, -42, 3.14159, 0xbeef, -12345, true, time,
+                     "a\"b", "abcdef");
+    check();
+
+    formatter.set(0u, 7u);
+    formatter.set(2u, 0.5);
+    formatter.set(6u, time + std::chrono::seconds{ 1 });
+    formatter.set(7u, "x");
+    formatter.set(8u, "ab");
+    compiled.set_some<0, 2, 6, 7, 8>(7u, 0.5, time + std::chrono::seconds{ 1 },
+                                      "x", "ab");
+    check();
+
+    // Values of other types are rejected
+    assert(formatter.set(0u, "1") == nullptr);
+    assert(formatter.set(7u, 1) == nullptr);
+    assert(formatter.set(2u, time) == nullptr);
+    check();
+    std::cout << "'" << cv << "'\n";
+
+    assert(!infmt::make_runtime_formatter("{unknown}"));
+    assert(!infmt::make_runtime_formatter("{a:str4}{a:str4}"));
+    assert(!infmt::make_runtime_formatter("{len:..}{mark}"));
+
+    // A name that starts like a type is a name
+    auto named = *infmt::make_runtime_formatter("a={strike:uint32_t}|");
+    assert(named.size() == 13u);
+    assert(named.index_of("strike") == 0u);
+    assert(named.set(0u, 4100u) != nullptr);
+    assert(named.to_string_view() == "a=4100      |");
+
+    // A missing name writes nothing
+    assert(named.index_of("typo") == named.npos);
+    assert(named.set(named.index_of("typo"), 42u) == nullptr);
+    assert(named.set(1u, std::string_view{ "x" }) == nullptr);
+    assert(named.set(named.npos, std::chrono::system_clock::now()) ==
+           nullptr);
+    assert(named.to_string_view() == "a=4100      |");
+  }
+  {
+    // A leading minus of a zero filled string isn't a sign
+    constexpr auto format_str =
+      INFMT_STRING("[{str8:0>}|{jstr8:0>}|{int8_t:0>4}]");
+    auto compiled = infmt::make_formatter(format_str);
+    auto formatter =
+      *infmt::make_runtime_formatter(format_str.to_string_view());
+
+    formatter.set(0u, "-ab");
+    formatter.set(1u, "-ab");
+    formatter.set(2u, -5);
+    compiled.set_all("-ab", "-ab", -5);
+    assert(formatter.to_string_view() == compiled.to_string_view());
+    assert(formatter.to_string_view() == "[00000-ab|00000-ab|-005]");
+    std::cout << "'" << formatter.to_string_view() << "'\n";
+  }
   {
     constexpr auto format_str = INFMT_STRING(R"#(
 {{